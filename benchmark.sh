@@ -0,0 +1,194 @@
+# Script for benchmarking galsim over the ellipse inputs in input_data.
+# Every combination of N, thread count and kernel gets warmup runs and then
+# timed trials. The time per step over the trials is reported as median and
+# 10th/90th percentile, together with interactions per second and the
+# parallel efficiency against the 1 thread run of the same kernel. Results
+# are written as CSV and JSON. If a baseline CSV from an earlier run exists,
+# a median more than the tolerance slower than its baseline is flagged as a
+# regression and the script exits with status 1.
+#
+# Usage: sh benchmark.sh [--sizes "N ..."] [--threads "T ..."] [--kernels "program/kernel ..."]
+#        [--steps S] [--warmup W] [--trials R] [--csv file] [--json file]
+#        [--baseline file] [--save-baseline] [--tolerance fraction]
+#
+# program is serial (implementation/galsim, always run on 1 thread) or
+# pthreads (parallelization/galsim), and kernel is one of its --kernel names.
+# --save-baseline copies the results over the baseline file for later runs.
+
+sizes=$(ls input_data/ellipse_N_*.gal | sed 's/.*ellipse_N_0*\([0-9]*\)\.gal/\1/')
+threads="1 2 4"
+kernels="serial/simd pthreads/direct pthreads/symmetric pthreads/simd"
+steps=10
+warmup=1
+trials=5
+csv=benchmark.csv
+json=benchmark.json
+baseline=benchmark_baseline.csv
+save_baseline=0
+tolerance=0.10
+
+while [ $# -gt 0 ]; do
+    case $1 in
+        --sizes) sizes=$2; shift ;;
+        --threads) threads=$2; shift ;;
+        --kernels) kernels=$2; shift ;;
+        --steps) steps=$2; shift ;;
+        --warmup) warmup=$2; shift ;;
+        --trials) trials=$2; shift ;;
+        --csv) csv=$2; shift ;;
+        --json) json=$2; shift ;;
+        --baseline) baseline=$2; shift ;;
+        --save-baseline) save_baseline=1 ;;
+        --tolerance) tolerance=$2; shift ;;
+        *) echo "Unknown option $1"; exit 1 ;;
+    esac
+    shift
+done
+
+echo Building galsim
+make -C implementation galsim > /dev/null || exit 1
+make -C parallelization galsim > /dev/null || exit 1
+
+rm -rf tmpdir_for_benchmark
+mkdir tmpdir_for_benchmark || exit 1
+raw=tmpdir_for_benchmark/raw.txt
+: > $raw
+
+# Prints the simulation time in seconds of one run, leaving out loading and saving
+run_galsim() {
+    "$@" --output tmpdir_for_benchmark/result.gal | grep "Time taken" | sed 's/.* = \([0-9.]*\) seconds./\1/'
+}
+
+for n in $sizes; do
+    input=input_data/ellipse_N_$(printf "%05d" $n).gal
+    if [ ! -f $input ]; then
+        echo "No input file $input, skipping N = $n"
+        continue
+    fi
+    for spec in $kernels; do
+        program=${spec%%/*}
+        kernel=${spec#*/}
+        case $program in
+            serial) thread_list=1 ;;
+            pthreads) thread_list=$threads ;;
+            *) echo "Unknown program $program in $spec, use serial or pthreads"; exit 1 ;;
+        esac
+        for t in $thread_list; do
+            if [ $program = serial ]; then
+                set -- implementation/galsim $n $input $steps 1e-5 0 --kernel $kernel
+            else
+                set -- parallelization/galsim $n $input $steps 1e-5 0 $t --kernel $kernel
+            fi
+            echo "Running $program/$kernel N = $n threads = $t"
+            w=0
+            while [ $w -lt $warmup ]; do
+                run_galsim "$@" > /dev/null
+                w=$((w + 1))
+            done
+            samples=""
+            r=0
+            while [ $r -lt $trials ]; do
+                time=$(run_galsim "$@")
+                if [ -z "$time" ]; then
+                    echo "$program/$kernel failed for N = $n threads = $t"
+                    exit 1
+                fi
+                samples="$samples $time"
+                r=$((r + 1))
+            done
+            echo "$program $kernel $n $t$samples" >> $raw
+        done
+    done
+done
+
+# The baseline is read first with comma separated fields, then the raw samples with blank separated ones
+baseline_input=""
+if [ -f "$baseline" ]; then
+    baseline_input=$baseline
+fi
+awk -F, -v baseline="$baseline_input" -v steps=$steps -v tolerance=$tolerance -v csv="$csv" -v json="$json" '
+# Linear interpolation between the sorted samples s[1..count]
+function percentile(p,    pos, lo)
+{
+    pos = 1 + p * (count - 1)
+    lo = int(pos)
+    return lo < count ? s[lo] + (pos - lo) * (s[lo + 1] - s[lo]) : s[count]
+}
+
+FILENAME == baseline {
+    if (FNR > 1)
+        base[$1 "/" $2 "/" $3 "/" $4] = $7
+    next
+}
+
+{
+    count = NF - 4
+    for (i = 1; i <= count; i++)
+        s[i] = 1000.0 * $(i + 4) / steps
+    for (i = 2; i <= count; i++)
+    {
+        v = s[i]
+        for (j = i - 1; j >= 1 && s[j] > v; j--)
+            s[j + 1] = s[j]
+        s[j + 1] = v
+    }
+    rows++
+    program[rows] = $1; kernel[rows] = $2; n[rows] = $3; threads[rows] = $4; trials[rows] = count
+    median[rows] = percentile(0.5); p10[rows] = percentile(0.1); p90[rows] = percentile(0.9); fastest[rows] = s[1]
+    if ($4 == 1)
+        single[$1 "/" $2 "/" $3] = median[rows]
+}
+
+END {
+    header = "program,kernel,N,threads,steps,trials,median_ms_per_step,p10_ms_per_step,p90_ms_per_step,min_ms_per_step," \
+             "interactions_per_second,parallel_efficiency,baseline_median_ms_per_step,status"
+    print header > csv
+    print "[" > json
+    printf "%-20s %6s %7s %12s %12s %12s %14s %10s %s\n", "kernel", "N", "threads", "median_ms", "p10_ms", "p90_ms",
+           "interactions/s", "efficiency", "status"
+    regressions = 0
+    for (r = 1; r <= rows; r++)
+    {
+        key = program[r] "/" kernel[r] "/" n[r]
+        interactions = n[r] * (n[r] - 1) / (median[r] / 1000.0)
+        efficiency = key in single ? sprintf("%.3f", single[key] / (threads[r] * median[r])) : ""
+        reference = key "/" threads[r] in base ? base[key "/" threads[r]] : ""
+        status = ""
+        if (reference != "")
+        {
+            status = "ok"
+            if (median[r] > reference * (1 + tolerance))
+            {
+                status = "regression"
+                regressions++
+            }
+            else if (median[r] < reference * (1 - tolerance))
+                status = "improved"
+        }
+        printf "%s,%s,%d,%d,%d,%d,%.6f,%.6f,%.6f,%.6f,%.0f,%s,%s,%s\n", program[r], kernel[r], n[r], threads[r], steps,
+               trials[r], median[r], p10[r], p90[r], fastest[r], interactions, efficiency, reference, status > csv
+        printf "  {\"program\": \"%s\", \"kernel\": \"%s\", \"N\": %d, \"threads\": %d, \"steps\": %d, \"trials\": %d, " \
+               "\"median_ms_per_step\": %.6f, \"p10_ms_per_step\": %.6f, \"p90_ms_per_step\": %.6f, " \
+               "\"min_ms_per_step\": %.6f, \"interactions_per_second\": %.0f, \"parallel_efficiency\": %s, " \
+               "\"baseline_median_ms_per_step\": %s, \"status\": %s}%s\n",
+               program[r], kernel[r], n[r], threads[r], steps, trials[r], median[r], p10[r], p90[r], fastest[r],
+               interactions, efficiency == "" ? "null" : efficiency, reference == "" ? "null" : reference,
+               status == "" ? "null" : "\"" status "\"", r < rows ? "," : "" > json
+        printf "%-20s %6d %7d %12.4f %12.4f %12.4f %14.4g %10s %s\n", program[r] "/" kernel[r], n[r], threads[r],
+               median[r], p10[r], p90[r], interactions, efficiency, status
+    }
+    print "]" > json
+    if (regressions > 0)
+        printf "%d regression(s) of more than %.0f%% against %s\n", regressions, 100 * tolerance, baseline
+    exit regressions > 0
+}
+' $baseline_input FS=' ' $raw
+status=$?
+
+if [ $save_baseline = 1 ]; then
+    cp $csv $baseline || exit 1
+    echo "Saved the results as baseline $baseline"
+fi
+
+rm -rf tmpdir_for_benchmark
+exit $status
@@ -0,0 +1,29 @@
+# Script for reporting the accuracy and speed of the mixed precision kernel
+# (--kernel mixed) against the double precision SIMD kernel (--kernel simd),
+# using the reference outputs in ref_output_data.
+
+rm -rf tmpdir_for_mixed
+mkdir tmpdir_for_mixed || exit 1
+cd tmpdir_for_mixed || exit 1
+
+echo Building galsim
+make -C ../implementation galsim > /dev/null || exit 1
+gcc -o compare_gal_files ../compare_gal_files/compare_gal_files.c -lm || exit 1
+
+echo
+printf "%-32s %16s %16s %10s %10s\n" reference pos_maxdiff_simd pos_maxdiff_mixed time_simd time_mixed
+for ref in ../ref_output_data/ellipse_N_*_after*steps.gal; do
+    name=$(basename $ref .gal)
+    n=$(echo $name | sed 's/ellipse_N_0*\([0-9]*\)_after.*/\1/')
+    steps=$(echo $name | sed 's/.*_after\([0-9]*\)steps/\1/')
+    input=../input_data/$(echo $name | sed 's/_after.*//').gal
+    for k in simd mixed; do
+        time=$(../implementation/galsim $n $input $steps 1e-5 0 --kernel $k | grep "Time taken" | sed 's/.* = \([0-9.]*\) seconds./\1/')
+        diff=$(./compare_gal_files $n result.gal $ref | grep pos_maxdiff | sed 's/.*= *//')
+        eval "time_$k=$time; diff_$k=$diff"
+    done
+    printf "%-32s %16s %16s %10s %10s\n" $name $diff_simd $diff_mixed $time_simd $time_mixed
+done
+
+cd ..
+rm -rf tmpdir_for_mixed
@@ -1,6 +1,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#ifdef HAVE_GSZ
+#include <string.h>
+#include "gsz.h"
+#endif
 
 static void update_maxdiff(double dx, double dy, double* maxabsdiff) {
   double absdiff = sqrt(dx*dx+dy*dy);
@@ -42,6 +46,65 @@ int read_doubles_from_file(int n, double* p, const char* fileName) {
   return 0;
 }
 
+#ifdef HAVE_GSZ
+/* Reads one frame of a compressed snapshot stream into the .gal layout.
+   "run.gsz" gives the last frame and "run.gsz@500" the frame of step 500. */
+int read_doubles_from_stream(int n, double* p, const char* fileName) {
+  char name[4096];
+  long wanted = -1;
+  strncpy(name, fileName, sizeof(name) - 1);
+  name[sizeof(name) - 1] = '\0';
+  char* at = strrchr(name, '@');
+  if(at) {
+    *at = '\0';
+    wanted = atol(at + 1);
+  }
+  GszHeader header;
+  GszStream* stream = gsz_reader_open(name, &header);
+  if(!stream)
+    return -1;
+  if(6 * (long)header.N != n) {
+    printf("read_doubles_from_stream error: stream '%s' holds %lu particles, not %d.\n",
+           name, (unsigned long)header.N, n / 6);
+    gsz_close(stream);
+    return -1;
+  }
+  int N = n / 6;
+  double* fields = malloc(6 * N * sizeof(double));
+  Particles frame = {fields, fields + N, fields + 2*N, fields + 3*N, fields + 4*N, NULL, NULL, fields + 5*N};
+  long step;
+  int found = 0;
+  int status;
+  while((status = gsz_reader_next(stream, &frame, &step)) == 1) {
+    found = 1;
+    if(step == wanted)
+      break;
+  }
+  gsz_close(stream);
+  if(status < 0 || !found || (wanted >= 0 && step != wanted)) {
+    printf("read_doubles_from_stream error: no usable frame%s in '%s'.\n", wanted >= 0 ? " for that step" : "", name);
+    free(fields);
+    return -1;
+  }
+  int i, f;
+  for(i = 0; i < N; i++)
+    for(f = 0; f < 6; f++)
+      p[i*6+f] = fields[f*N+i];
+  free(fields);
+  return 0;
+}
+#endif
+
+/* Picks the reader from the file name, so .gal files and (if built in)
+   .gsz streams can be compared with each other. */
+int read_input_file(int n, double* p, const char* fileName) {
+#ifdef HAVE_GSZ
+  if(strstr(fileName, ".gsz"))
+    return read_doubles_from_stream(n, p, fileName);
+#endif
+  return read_doubles_from_file(n, p, fileName);
+}
+
 /* The idea with the check_that_numbers_seem_OK() function is to check
    that there are no strange numbers like "nan" that may give problems
    when we try to compare the numbers later. */
@@ -62,8 +125,12 @@ int check_that_numbers_seem_OK(int n, double* buf) {
 }
 
 int main(int argc, const char* argv[]) {
-  if(argc != 4) {
+  if(argc != 4 && argc != 5) {
     printf("Give 3 input args: N gal1.gal gal2.gal\n");
+#ifdef HAVE_GSZ
+    printf("A .gsz stream can be given instead of a .gal file, as run.gsz (last frame) or run.gsz@step.\n");
+#endif
+    printf("An optional 4th arg sets the largest accepted pos_maxdiff.\n");
     return -1;
   }
   int N = atoi(argv[1]);
@@ -74,7 +141,7 @@ int main(int argc, const char* argv[]) {
   printf("fileName2 = '%s'\n", fileName2);
   /* Read files. */
   double buf1[6*N];
-  if(read_doubles_from_file(6*N, buf1, fileName1) != 0) {
+  if(read_input_file(6*N, buf1, fileName1) != 0) {
     printf("Error reading file '%s'\n", fileName1);
     return -1;
   }
@@ -83,7 +150,7 @@ int main(int argc, const char* argv[]) {
     return -1;
   }
   double buf2[6*N];
-  if(read_doubles_from_file(6*N, buf2, fileName2) != 0) {
+  if(read_input_file(6*N, buf2, fileName2) != 0) {
     printf("Error reading file '%s'\n", fileName2);
     return -1;
   }
@@ -114,5 +181,14 @@ int main(int argc, const char* argv[]) {
     update_maxdiff(vel_dx, vel_dy, &vel_maxdiff);
   }
   printf("pos_maxdiff = %16.12f\n", pos_maxdiff);
+  if(argc == 5) {
+    /* Approximate force methods (e.g. Barnes-Hut) are checked against
+       the direct sum with an explicit tolerance. */
+    double tolerance = atof(argv[4]);
+    if(pos_maxdiff > tolerance) {
+      printf("ERROR: pos_maxdiff exceeds tolerance %g.\n", tolerance);
+      return -1;
+    }
+  }
   return 0;
 }
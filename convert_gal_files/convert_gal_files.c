@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "gal_io.h"
+#include "galsnap.h"
+
+/* Converts between the raw .gal layout and .gsnap snapshots. The input
+   format is detected from the file contents and the output format from
+   the extension of the output file name. */
+int main(int argc, const char* argv[]) {
+  if(argc != 4 && argc != 5) {
+    printf("Give 3 input args: N input output\n");
+    printf("Input may be .gal or .gsnap, output is .gsnap if its name ends in .gsnap and .gal otherwise.\n");
+    printf("An optional 4th arg sets delta_t for the .gsnap header when the input is .gal.\n");
+    return -1;
+  }
+  int N = atoi(argv[1]);
+  const char* inputName = argv[2];
+  const char* outputName = argv[3];
+  long step = 0;
+  double delta_t = argc == 5 ? atof(argv[4]) : 0.0;
+
+  Particles* particles;
+  if(galsnap_is_snapshot(inputName)) {
+    /* Keep the step and time stamp of the input snapshot. */
+    GalsnapHeader header;
+    particles = galsnap_load(inputName, N, &header);
+    if(particles != NULL) {
+      step = (long)header.step;
+      delta_t = header.delta_t;
+    }
+  }
+  else {
+    particles = read_data_v2(N, inputName);
+  }
+  if(particles == NULL) {
+    printf("Error reading file '%s'\n", inputName);
+    return -1;
+  }
+
+  if(save_particles(N, particles, outputName, step, delta_t) != 0) {
+    printf("Error writing file '%s'\n", outputName);
+    free_particles(particles);
+    return -1;
+  }
+  printf("Converted %d particles from '%s' to '%s'.\n", N, inputName, outputName);
+  free_particles(particles);
+  return 0;
+}
@@ -0,0 +1,77 @@
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "arena.h"
+
+// Explicit huge page mappings must be a multiple of the huge page size
+#define HUGE_PAGE_BYTES (2UL << 20)
+
+size_t arena_bytes(size_t bytes)
+{
+    return (bytes + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+}
+
+Arena *arena_create(size_t bytes, int huge_pages)
+{
+    // An empty arena still maps one page so every block has a valid address
+    size_t capacity = arena_bytes(bytes > 0 ? bytes : ARENA_ALIGNMENT);
+    void *base = MAP_FAILED;
+    int huge = 0;
+
+#ifdef MAP_HUGETLB
+    if (huge_pages)
+    {
+        size_t huge_capacity = (capacity + HUGE_PAGE_BYTES - 1) / HUGE_PAGE_BYTES * HUGE_PAGE_BYTES;
+        base = mmap(NULL, huge_capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (base != MAP_FAILED)
+        {
+            capacity = huge_capacity;
+            huge = 1;
+        }
+    }
+#endif
+    if (base == MAP_FAILED)
+    {
+        base = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED)
+        {
+            return NULL;
+        }
+#ifdef MADV_HUGEPAGE
+        // No reserved huge pages, ask for transparent ones instead (failure is harmless)
+        if (huge_pages)
+        {
+            madvise(base, capacity, MADV_HUGEPAGE);
+        }
+#endif
+    }
+
+    Arena *arena = malloc(sizeof(Arena));
+    arena->base = base;
+    arena->capacity = capacity;
+    arena->used = 0;
+    arena->huge_pages = huge;
+    return arena;
+}
+
+void *arena_alloc(Arena *arena, size_t bytes)
+{
+    size_t size = arena_bytes(bytes);
+    if (size > arena->capacity - arena->used)
+    {
+        return NULL;
+    }
+    // Fresh anonymous pages are zero and blocks are never reused, so no memset is needed
+    void *block = arena->base + arena->used;
+    arena->used += size;
+    return block;
+}
+
+void arena_destroy(Arena *arena)
+{
+    if (arena == NULL)
+    {
+        return;
+    }
+    munmap(arena->base, arena->capacity);
+    free(arena);
+}
@@ -0,0 +1,60 @@
+#ifndef _arena_h
+#define _arena_h
+
+#include <stddef.h>
+
+// Every block handed out by arena_alloc starts on this boundary
+#define ARENA_ALIGNMENT 64
+
+/*
+ * A single anonymous mapping that is carved into blocks by a bump pointer.
+ * Blocks are never freed one by one, the whole arena goes away with
+ * arena_destroy. huge_pages records whether the mapping is backed by
+ * explicit huge pages (1) or only advised to use transparent ones (0).
+ */
+typedef struct Arena
+{
+    char *base;
+    size_t capacity;
+    size_t used;
+    int huge_pages;
+} Arena;
+
+/*
+ * Function: arena_create
+ * Usage: Arena *arena = arena_create(bytes, huge_pages);
+ * ------------------------------------------------------
+ * Maps an arena with room for at least bytes of blocks. If huge_pages is
+ * nonzero the mapping is first tried with MAP_HUGETLB and otherwise falls
+ * back to normal pages with a MADV_HUGEPAGE hint. Returns NULL if no
+ * memory could be mapped.
+ */
+Arena *arena_create(size_t bytes, int huge_pages);
+
+/*
+ * Function: arena_alloc
+ * Usage: double *array = arena_alloc(arena, N * sizeof(double));
+ * --------------------------------------------------------------
+ * Returns a zero-filled, ARENA_ALIGNMENT aligned block of bytes, or NULL
+ * if the arena is full.
+ */
+void *arena_alloc(Arena *arena, size_t bytes);
+
+/*
+ * Function: arena_bytes
+ * Usage: size_t bytes = arena_bytes(N * sizeof(double));
+ * ------------------------------------------------------
+ * Returns the room a block of bytes takes in an arena, including the
+ * padding up to the next aligned block.
+ */
+size_t arena_bytes(size_t bytes);
+
+/*
+ * Function: arena_destroy
+ * Usage: arena_destroy(arena);
+ * ----------------------------
+ * Unmaps the arena and every block allocated from it. NULL is ignored.
+ */
+void arena_destroy(Arena *arena);
+
+#endif
@@ -0,0 +1,235 @@
+#include <stdlib.h>
+#include <math.h>
+#include "barnes_hut.h"
+
+// Particles closer than this many subdivisions apart share one leaf
+#define MAX_DEPTH 48
+
+static int new_node(QuadTree *tree, double cx, double cy, double half)
+{
+    if (tree->node_count == tree->node_capacity)
+    {
+        tree->node_capacity *= 2;
+        tree->nodes = realloc(tree->nodes, tree->node_capacity * sizeof(QuadNode));
+    }
+
+    int n = tree->node_count++;
+    QuadNode *node = &tree->nodes[n];
+    node->com_x = 0.0;
+    node->com_y = 0.0;
+    node->mass = 0.0;
+    node->cx = cx;
+    node->cy = cy;
+    node->half = half;
+    node->child[0] = node->child[1] = node->child[2] = node->child[3] = -1;
+    node->first = -1;
+    return n;
+}
+
+// Creates child q of node n holding a single particle. May move tree->nodes.
+static void new_leaf(QuadTree *tree, int n, int q, int particle)
+{
+    double half = 0.5 * tree->nodes[n].half;
+    double cx = tree->nodes[n].cx + ((q & 1) ? half : -half);
+    double cy = tree->nodes[n].cy + ((q & 2) ? half : -half);
+    int c = new_node(tree, cx, cy, half);
+    tree->nodes[n].child[q] = c;
+    tree->nodes[c].first = particle;
+    tree->next[particle] = -1;
+}
+
+static int quadrant(const QuadNode *node, double x, double y)
+{
+    return (x >= node->cx) + 2 * (y >= node->cy);
+}
+
+static void insert_particle(QuadTree *tree, const Particles *particles, int i)
+{
+    const double x = particles->posx[i];
+    const double y = particles->posy[i];
+    int n = 0;
+
+    for (int depth = 0;; depth++)
+    {
+        if (tree->nodes[n].first != -1)
+        {
+            // Occupied leaf: stack the particle when we cannot subdivide any further, otherwise push the resident one down
+            if (depth >= MAX_DEPTH)
+            {
+                tree->next[i] = tree->nodes[n].first;
+                tree->nodes[n].first = i;
+                return;
+            }
+            int j = tree->nodes[n].first;
+            tree->nodes[n].first = -1;
+            new_leaf(tree, n, quadrant(&tree->nodes[n], particles->posx[j], particles->posy[j]), j);
+        }
+
+        int q = quadrant(&tree->nodes[n], x, y);
+        if (tree->nodes[n].child[q] == -1)
+        {
+            new_leaf(tree, n, q, i);
+            return;
+        }
+        n = tree->nodes[n].child[q];
+    }
+}
+
+QuadTree *quadtree_create(int particle_count)
+{
+    QuadTree *tree = malloc(sizeof(QuadTree));
+    tree->particle_count = particle_count;
+    tree->node_count = 0;
+    tree->node_capacity = 2 * particle_count + 1;
+    tree->nodes = malloc(tree->node_capacity * sizeof(QuadNode));
+    tree->next = malloc(particle_count * sizeof(int));
+    // Every level of the walk pops one node and pushes at most four
+    tree->stack = malloc((3 * MAX_DEPTH + 8) * sizeof(int));
+    return tree;
+}
+
+void quadtree_build(QuadTree *tree, const Particles *particles)
+{
+    const int N = tree->particle_count;
+    tree->node_count = 0;
+    if (N == 0)
+    {
+        return;
+    }
+
+    double min_x = particles->posx[0], max_x = particles->posx[0];
+    double min_y = particles->posy[0], max_y = particles->posy[0];
+    for (int i = 1; i < N; i++)
+    {
+        min_x = fmin(min_x, particles->posx[i]);
+        max_x = fmax(max_x, particles->posx[i]);
+        min_y = fmin(min_y, particles->posy[i]);
+        max_y = fmax(max_y, particles->posy[i]);
+    }
+
+    // Pad the root slightly so that particles on the upper edge stay inside
+    double half = 0.5 * fmax(max_x - min_x, max_y - min_y);
+    half = half * (1.0 + 1e-12) + 1e-300;
+    int root = new_node(tree, 0.5 * (min_x + max_x), 0.5 * (min_y + max_y), half);
+    tree->nodes[root].first = 0;
+    tree->next[0] = -1;
+
+    for (int i = 1; i < N; i++)
+    {
+        insert_particle(tree, particles, i);
+    }
+
+    // Children are always created after their parent, so a reverse sweep visits them first
+    for (int n = tree->node_count - 1; n >= 0; n--)
+    {
+        QuadNode *node = &tree->nodes[n];
+        double m = 0.0, mx = 0.0, my = 0.0;
+        if (node->first != -1)
+        {
+            for (int j = node->first; j != -1; j = tree->next[j])
+            {
+                m += particles->mass[j];
+                mx += particles->mass[j] * particles->posx[j];
+                my += particles->mass[j] * particles->posy[j];
+            }
+        }
+        else
+        {
+            for (int q = 0; q < 4; q++)
+            {
+                if (node->child[q] != -1)
+                {
+                    const QuadNode *child = &tree->nodes[node->child[q]];
+                    m += child->mass;
+                    mx += child->mass * child->com_x;
+                    my += child->mass * child->com_y;
+                }
+            }
+        }
+        node->mass = m;
+        node->com_x = m > 0.0 ? mx / m : node->cx;
+        node->com_y = m > 0.0 ? my / m : node->cy;
+    }
+}
+
+void update_acceleration_bh(QuadTree *tree, Particles *particles, double theta, double epsilon)
+{
+    const int N = tree->particle_count;
+    const double theta2 = theta * theta;
+    const QuadNode *nodes = tree->nodes;
+    int *stack = tree->stack;
+
+    // Variables needed for calcluations
+    double rx, ry, r, rr, div_1_rr;
+
+    for (int i = 0; i < N; i++)
+    {
+        const double xi = particles->posx[i];
+        const double yi = particles->posy[i];
+        double aXi = 0.0;
+        double aYi = 0.0;
+
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0)
+        {
+            const QuadNode *node = &nodes[stack[--top]];
+
+            if (node->first != -1)
+            {
+                // Leaves are evaluated exactly
+                for (int j = node->first; j != -1; j = tree->next[j])
+                {
+                    if (j != i)
+                    {
+                        rx = xi - particles->posx[j];
+                        ry = yi - particles->posy[j];
+                        r = sqrt(rx * rx + ry * ry);
+                        rr = r + epsilon;
+                        div_1_rr = 1 / (rr * rr * rr);
+                        aXi += particles->mass[j] * rx * div_1_rr;
+                        aYi += particles->mass[j] * ry * div_1_rr;
+                    }
+                }
+                continue;
+            }
+
+            rx = xi - node->com_x;
+            ry = yi - node->com_y;
+            double r2 = rx * rx + ry * ry;
+            double width = 2.0 * node->half;
+            int outside = fabs(xi - node->cx) > node->half || fabs(yi - node->cy) > node->half;
+
+            if (outside && width * width < theta2 * r2)
+            {
+                // Far enough away: the whole node acts as a point mass at its centre of mass
+                r = sqrt(r2);
+                rr = r + epsilon;
+                div_1_rr = 1 / (rr * rr * rr);
+                aXi += node->mass * rx * div_1_rr;
+                aYi += node->mass * ry * div_1_rr;
+            }
+            else
+            {
+                for (int q = 0; q < 4; q++)
+                {
+                    if (node->child[q] != -1)
+                    {
+                        stack[top++] = node->child[q];
+                    }
+                }
+            }
+        }
+
+        particles->accx[i] = aXi;
+        particles->accy[i] = aYi;
+    }
+}
+
+void quadtree_destroy(QuadTree *tree)
+{
+    free(tree->nodes);
+    free(tree->next);
+    free(tree->stack);
+    free(tree);
+}
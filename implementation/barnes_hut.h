@@ -0,0 +1,63 @@
+#ifndef _barnes_hut_h
+#define _barnes_hut_h
+
+#include "particles.h"
+
+/*
+ * Quadtree node. Internal nodes have at least one child, leaves keep their
+ * particles as a linked list starting at "first" (see QuadTree.next).
+ */
+typedef struct
+{
+    double com_x;
+    double com_y;
+    double mass;
+    double cx;
+    double cy;
+    double half;
+    int child[4];
+    int first;
+} QuadNode;
+
+typedef struct
+{
+    QuadNode *nodes;
+    int node_count;
+    int node_capacity;
+    int *next;
+    int *stack;
+    int particle_count;
+} QuadTree;
+
+/*
+ * Function: quadtree_create
+ * Usage: QuadTree *tree = quadtree_create(N);
+ * -------------------------------------------
+ * Allocates a tree able to hold N particles. The node pool grows on demand
+ * and is reused by every call to quadtree_build.
+ */
+QuadTree *quadtree_create(int particle_count);
+
+/*
+ * Function: quadtree_build
+ * Usage: quadtree_build(tree, particles);
+ * ---------------------------------------
+ * Rebuilds the tree from the current positions and computes the mass and
+ * centre of mass of every node.
+ */
+void quadtree_build(QuadTree *tree, const Particles *particles);
+
+/*
+ * Function: update_acceleration_bh
+ * Usage: update_acceleration_bh(tree, particles, theta, epsilon);
+ * ---------------------------------------------------------------
+ * Fills accx/accy with the sum of m_j * r_ij / (|r_ij| + epsilon)^3 using
+ * the Barnes-Hut approximation. A node of width s at distance d from a
+ * particle is treated as a point mass when s / d < theta, so theta = 0
+ * degenerates to the direct sum.
+ */
+void update_acceleration_bh(QuadTree *tree, Particles *particles, double theta, double epsilon);
+
+void quadtree_destroy(QuadTree *tree);
+
+#endif
@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "block_steps.h"
+
+// Deepest bin whose step still fits the particle's own step, limited to 0..levels
+static int choose_bin(const BlockSteps *steps, const Particles *particles, int i, double delta_t)
+{
+    double a = steps->G * sqrt(particles->accx[i] * particles->accx[i] + particles->accy[i] * particles->accy[i]);
+    if (a == 0.0)
+    {
+        return 0;
+    }
+    double dt_i = sqrt(2.0 * steps->eta * steps->epsilon / a);
+    int k = 0;
+    while (k < steps->levels && delta_t / (1 << k) > dt_i)
+    {
+        k++;
+    }
+    return k;
+}
+
+// Recomputes accx/accy of the particles in the active list against all particles
+static void compute_active(BlockSteps *steps, Particles *particles, int count)
+{
+    int n = 0;
+    while (n < count)
+    {
+        // Consecutive indices are handed to the kernel as one block of rows
+        int first = steps->active[n];
+        int last = first;
+        while (n + 1 < count && steps->active[n + 1] == last + 1)
+        {
+            n++;
+            last++;
+        }
+        n++;
+
+        for (int i = first; i <= last; i++)
+        {
+            particles->accx[i] = 0.0;
+            particles->accy[i] = 0.0;
+        }
+        steps->block(particles, first, last + 1, 0, steps->N, steps->epsilon);
+    }
+    steps->rows_computed += count;
+}
+
+static void kick(const BlockSteps *steps, Particles *particles, int i, double dt)
+{
+    particles->velx[i] -= steps->G * dt * particles->accx[i];
+    particles->vely[i] -= steps->G * dt * particles->accy[i];
+}
+
+BlockSteps *block_steps_create(Particles *particles, int N, int levels, double eta, double epsilon, double G)
+{
+    BlockSteps *steps = malloc(sizeof(BlockSteps));
+    const char *kernel_name;
+    steps->N = N;
+    steps->levels = levels;
+    steps->eta = eta;
+    steps->epsilon = epsilon;
+    steps->G = G;
+    steps->block = select_acceleration_block_kernel(&kernel_name);
+    steps->bin = calloc(N, sizeof(int));
+    steps->active = malloc(N * sizeof(int));
+    steps->rows_computed = 0;
+    steps->rows_full = 0;
+    printf("Using the %s force kernel with %d block time step levels.\n", kernel_name, levels);
+
+    for (int i = 0; i < N; i++)
+    {
+        steps->active[i] = i;
+    }
+    compute_active(steps, particles, N);
+    steps->rows_computed = 0;
+    return steps;
+}
+
+void block_steps_advance(BlockSteps *steps, Particles *particles, double delta_t)
+{
+    const int N = steps->N;
+    const int ticks = 1 << steps->levels;
+    const double dt_tick = delta_t / ticks;
+
+    // All particles are synchronized here, so every one may take any bin
+    for (int i = 0; i < N; i++)
+    {
+        steps->bin[i] = choose_bin(steps, particles, i, delta_t);
+        kick(steps, particles, i, 0.5 * delta_t / (1 << steps->bin[i]));
+    }
+
+    for (int tick = 1; tick <= ticks; tick++)
+    {
+        for (int i = 0; i < N; i++)
+        {
+            particles->posx[i] += particles->velx[i] * dt_tick;
+            particles->posy[i] += particles->vely[i] * dt_tick;
+        }
+
+        // A particle in bin k ends its step on every 2^(levels - k)-th tick
+        int count = 0;
+        for (int i = 0; i < N; i++)
+        {
+            if (tick % (ticks >> steps->bin[i]) == 0)
+            {
+                steps->active[count++] = i;
+            }
+        }
+        compute_active(steps, particles, count);
+
+        for (int n = 0; n < count; n++)
+        {
+            int i = steps->active[n];
+            kick(steps, particles, i, 0.5 * delta_t / (1 << steps->bin[i]));
+            if (tick == ticks)
+            {
+                continue;
+            }
+
+            // Smaller steps are always aligned, a larger step only if this tick is on its grid
+            int k = choose_bin(steps, particles, i, delta_t);
+            if (k < steps->bin[i])
+            {
+                k = steps->bin[i] - 1;
+                if (tick % (ticks >> k) != 0)
+                {
+                    k = steps->bin[i];
+                }
+            }
+            steps->bin[i] = k;
+            kick(steps, particles, i, 0.5 * delta_t / (1 << k));
+        }
+    }
+    steps->rows_full += (long long)N * ticks;
+}
+
+void block_steps_destroy(BlockSteps *steps)
+{
+    free(steps->bin);
+    free(steps->active);
+    free(steps);
+}
@@ -0,0 +1,57 @@
+#ifndef _block_steps_h
+#define _block_steps_h
+
+#include "particles.h"
+#include "simd_kernel.h"
+
+/*
+ * Hierarchical (block) time steps. Each particle steps with delta_t / 2^k
+ * for a bin k in 0..levels, chosen from its acceleration as
+ * dt_i = sqrt(2 * eta * epsilon / |G a_i|). A base step of delta_t is
+ * made of 2^levels ticks. Every tick drifts all particles, but forces are
+ * only recomputed for the particles whose own step ends on that tick.
+ * Each particle is integrated with kick-drift-kick leapfrog, and all of
+ * them are synchronized again at the end of every base step.
+ */
+typedef struct
+{
+    int N;
+    int levels;
+    double eta;
+    double epsilon;
+    double G;
+    AccelerationBlockKernel block;
+    int *bin;
+    int *active;
+    // Force rows evaluated, and the rows a global step of the smallest size would have needed
+    long long rows_computed;
+    long long rows_full;
+} BlockSteps;
+
+/*
+ * Function: block_steps_create
+ * Usage: BlockSteps *steps = block_steps_create(particles, N, 6, 0.025, epsilon, G);
+ * -----------------------------------------------------------------------------------
+ * Computes the initial accelerations of all particles. Release with
+ * block_steps_destroy.
+ */
+BlockSteps *block_steps_create(Particles *particles, int N, int levels, double eta, double epsilon, double G);
+
+/*
+ * Function: block_steps_advance
+ * Usage: block_steps_advance(steps, particles, delta_t);
+ * ------------------------------------------------------
+ * Advances every particle by one base step of delta_t. Positions and
+ * velocities are synchronized on return, so they can be written out.
+ */
+void block_steps_advance(BlockSteps *steps, Particles *particles, double delta_t);
+
+/*
+ * Function: block_steps_destroy
+ * Usage: block_steps_destroy(steps);
+ * ----------------------------------
+ * Frees the bins and the active list.
+ */
+void block_steps_destroy(BlockSteps *steps);
+
+#endif
@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include "checkpoint.h"
+#include "gal_io.h"
+
+static double wall_seconds()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + (double)tv.tv_usec / 1000000;
+}
+
+static int write_all(int fd, const void *data, size_t bytes)
+{
+    const char *p = data;
+    while (bytes > 0)
+    {
+        ssize_t written = write(fd, p, bytes);
+        if (written <= 0)
+        {
+            return -1;
+        }
+        p += written;
+        bytes -= written;
+    }
+    return 0;
+}
+
+static int read_all(int fd, void *data, size_t bytes)
+{
+    char *p = data;
+    while (bytes > 0)
+    {
+        ssize_t got = read(fd, p, bytes);
+        if (got <= 0)
+        {
+            return -1;
+        }
+        p += got;
+        bytes -= got;
+    }
+    return 0;
+}
+
+int checkpoint_save(const char *filename, CheckpointHeader *header, const Particles *particles)
+{
+    memset(header->magic, 0, sizeof(header->magic));
+    memcpy(header->magic, CHECKPOINT_MAGIC, strlen(CHECKPOINT_MAGIC));
+    header->version = CHECKPOINT_VERSION;
+
+    size_t name_length = strlen(filename) + 5;
+    char *tmp_name = malloc(name_length);
+    snprintf(tmp_name, name_length, "%s.tmp", filename);
+
+    int fd = open(tmp_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        printf("Failed to open the checkpoint file '%s'.\n", tmp_name);
+        free(tmp_name);
+        return -1;
+    }
+
+    const double *fields[6] = {particles->posx, particles->posy, particles->mass,
+                               particles->velx, particles->vely, particles->brightness};
+    size_t bytes = (size_t)header->N * sizeof(double);
+    int status = write_all(fd, header, sizeof(CheckpointHeader));
+    for (int f = 0; f < 6 && status == 0; f++)
+    {
+        status = write_all(fd, fields[f], bytes);
+    }
+
+    // The data must be on disk before the rename makes it the current checkpoint
+    if (status == 0)
+    {
+        status = fsync(fd);
+    }
+    if (close(fd) != 0)
+    {
+        status = -1;
+    }
+    if (status == 0)
+    {
+        status = rename(tmp_name, filename);
+    }
+    if (status != 0)
+    {
+        printf("Failed to write the checkpoint file '%s'.\n", filename);
+        unlink(tmp_name);
+    }
+
+    free(tmp_name);
+    return status == 0 ? 0 : -1;
+}
+
+Particles *checkpoint_load(const char *filename, CheckpointHeader *header)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        printf("Failed to open the checkpoint file '%s'.\n", filename);
+        return NULL;
+    }
+
+    if (read_all(fd, header, sizeof(CheckpointHeader)) != 0 ||
+        strncmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != CHECKPOINT_VERSION || header->N < 0)
+    {
+        printf("'%s' is not a checkpoint file.\n", filename);
+        close(fd);
+        return NULL;
+    }
+
+    Particles *particles = alloc_particles(header->N);
+    if (particles == NULL)
+    {
+        printf("Failed to allocate the particles for '%s'.\n", filename);
+        close(fd);
+        return NULL;
+    }
+    double *fields[6] = {particles->posx, particles->posy, particles->mass,
+                         particles->velx, particles->vely, particles->brightness};
+    size_t bytes = (size_t)header->N * sizeof(double);
+    for (int f = 0; f < 6; f++)
+    {
+        if (read_all(fd, fields[f], bytes) != 0)
+        {
+            printf("The checkpoint file '%s' is truncated.\n", filename);
+            free_particles(particles);
+            close(fd);
+            return NULL;
+        }
+    }
+    close(fd);
+
+    memset(particles->accx, 0, bytes);
+    memset(particles->accy, 0, bytes);
+    return particles;
+}
+
+void checkpoint_schedule_init(CheckpointSchedule *schedule, const char *filename, int every, double interval,
+                              int N, double delta_t, double G, double epsilon)
+{
+    schedule->filename = filename;
+    schedule->every = every;
+    schedule->interval = interval;
+    schedule->last_time = wall_seconds();
+    memset(&schedule->header, 0, sizeof(CheckpointHeader));
+    schedule->header.N = N;
+    schedule->header.delta_t = delta_t;
+    schedule->header.G = G;
+    schedule->header.epsilon = epsilon;
+}
+
+void checkpoint_step(CheckpointSchedule *schedule, const Particles *particles, int step)
+{
+    int due = schedule->every > 0 && step % schedule->every == 0;
+    if (!due && schedule->interval > 0.0)
+    {
+        due = wall_seconds() - schedule->last_time >= schedule->interval;
+    }
+    if (!due)
+    {
+        return;
+    }
+
+    schedule->header.step = step;
+    checkpoint_save(schedule->filename, &schedule->header, particles);
+    schedule->last_time = wall_seconds();
+}
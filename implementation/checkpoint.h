@@ -0,0 +1,79 @@
+#ifndef _checkpoint_h
+#define _checkpoint_h
+
+#include <stdint.h>
+#include "particles.h"
+
+#define CHECKPOINT_MAGIC "GALCKPT"
+#define CHECKPOINT_VERSION 1
+
+/*
+ * Fixed-size header at the start of a checkpoint file. It is followed by
+ * the posx, posy, mass, velx, vely and brightness arrays, N doubles each.
+ * step is the number of completed steps.
+ */
+typedef struct
+{
+    char magic[8];
+    int32_t version;
+    int32_t N;
+    int64_t step;
+    double delta_t;
+    double G;
+    double epsilon;
+} CheckpointHeader;
+
+/*
+ * When to write checkpoints during a run: after every "every" steps
+ * and/or once "interval" seconds of wall time have passed since the last
+ * one. A zero value switches that trigger off.
+ */
+typedef struct
+{
+    const char *filename;
+    int every;
+    double interval;
+    double last_time;
+    CheckpointHeader header;
+} CheckpointSchedule;
+
+/*
+ * Function: checkpoint_schedule_init
+ * Usage: checkpoint_schedule_init(&schedule, "checkpoint.bin", 0, 300.0, N, delta_t, G, epsilon);
+ * -----------------------------------------------------------------------------------------------
+ * Sets up the schedule and records the run parameters stored in every
+ * checkpoint. The interval clock starts now.
+ */
+void checkpoint_schedule_init(CheckpointSchedule *schedule, const char *filename, int every, double interval,
+                              int N, double delta_t, double G, double epsilon);
+
+/*
+ * Function: checkpoint_step
+ * Usage: checkpoint_step(&schedule, particles, step + 1);
+ * -------------------------------------------------------
+ * Call after every completed step. Writes a checkpoint with checkpoint_save
+ * when one of the triggers has fired.
+ */
+void checkpoint_step(CheckpointSchedule *schedule, const Particles *particles, int step);
+
+/*
+ * Function: checkpoint_save
+ * Usage: checkpoint_save("checkpoint.bin", &header, particles);
+ * -------------------------------------------------------------
+ * Writes the header and the state to filename.tmp, flushes it to disk and
+ * renames it over filename. A crash during the write therefore leaves the
+ * previous checkpoint intact. magic and version are filled in here.
+ * Returns 0 on success and -1 on failure.
+ */
+int checkpoint_save(const char *filename, CheckpointHeader *header, const Particles *particles);
+
+/*
+ * Function: checkpoint_load
+ * Usage: Particles *particles = checkpoint_load("checkpoint.bin", &header);
+ * -------------------------------------------------------------------------
+ * Reads a checkpoint written by checkpoint_save. accx/accy are zeroed.
+ * Returns NULL if the file is missing, truncated or not a checkpoint.
+ */
+Particles *checkpoint_load(const char *filename, CheckpointHeader *header);
+
+#endif
@@ -0,0 +1,127 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "fft.h"
+
+// Transposes in tiles so that both the reads and the writes stay within a few cache lines
+#define TRANSPOSE_TILE 16
+
+FftPlan *fft_plan_create(int n)
+{
+    if (n < 1 || (n & (n - 1)) != 0)
+    {
+        return NULL;
+    }
+
+    FftPlan *plan = malloc(sizeof(FftPlan));
+    plan->n = n;
+    plan->bit_reverse = malloc(n * sizeof(int));
+    plan->twiddle = malloc((n / 2 + 1) * 2 * sizeof(double));
+    plan->scratch = malloc((size_t)n * n * 2 * sizeof(double));
+
+    int bits = 0;
+    while ((1 << bits) < n)
+    {
+        bits++;
+    }
+    for (int i = 0; i < n; i++)
+    {
+        int r = 0;
+        for (int b = 0; b < bits; b++)
+        {
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        plan->bit_reverse[i] = r;
+    }
+    for (int k = 0; k < n / 2; k++)
+    {
+        double angle = 2.0 * M_PI * k / n;
+        plan->twiddle[2 * k] = cos(angle);
+        plan->twiddle[2 * k + 1] = -sin(angle);
+    }
+    return plan;
+}
+
+void fft_1d(const FftPlan *plan, double *data, int inverse)
+{
+    const int n = plan->n;
+    for (int i = 0; i < n; i++)
+    {
+        int r = plan->bit_reverse[i];
+        if (r > i)
+        {
+            double re = data[2 * i], im = data[2 * i + 1];
+            data[2 * i] = data[2 * r];
+            data[2 * i + 1] = data[2 * r + 1];
+            data[2 * r] = re;
+            data[2 * r + 1] = im;
+        }
+    }
+
+    const double sign = inverse ? -1.0 : 1.0;
+    for (int length = 2; length <= n; length *= 2)
+    {
+        const int half = length / 2;
+        const int step = n / length;
+        for (int start = 0; start < n; start += length)
+        {
+            for (int k = 0; k < half; k++)
+            {
+                double wr = plan->twiddle[2 * k * step];
+                double wi = sign * plan->twiddle[2 * k * step + 1];
+                double *a = data + 2 * (start + k);
+                double *b = data + 2 * (start + k + half);
+                double tr = b[0] * wr - b[1] * wi;
+                double ti = b[0] * wi + b[1] * wr;
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+            }
+        }
+    }
+}
+
+static void transpose(FftPlan *plan, double *data)
+{
+    const int n = plan->n;
+    double *out = plan->scratch;
+    for (int ii = 0; ii < n; ii += TRANSPOSE_TILE)
+    {
+        for (int jj = 0; jj < n; jj += TRANSPOSE_TILE)
+        {
+            int i_end = ii + TRANSPOSE_TILE < n ? ii + TRANSPOSE_TILE : n;
+            int j_end = jj + TRANSPOSE_TILE < n ? jj + TRANSPOSE_TILE : n;
+            for (int i = ii; i < i_end; i++)
+            {
+                for (int j = jj; j < j_end; j++)
+                {
+                    out[2 * ((size_t)j * n + i)] = data[2 * ((size_t)i * n + j)];
+                    out[2 * ((size_t)j * n + i) + 1] = data[2 * ((size_t)i * n + j) + 1];
+                }
+            }
+        }
+    }
+    memcpy(data, out, (size_t)n * n * 2 * sizeof(double));
+}
+
+void fft_2d(FftPlan *plan, double *data, int inverse)
+{
+    const int n = plan->n;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int row = 0; row < n; row++)
+        {
+            fft_1d(plan, data + 2 * (size_t)row * n, inverse);
+        }
+        transpose(plan, data);
+    }
+}
+
+void fft_plan_destroy(FftPlan *plan)
+{
+    free(plan->bit_reverse);
+    free(plan->twiddle);
+    free(plan->scratch);
+    free(plan);
+}
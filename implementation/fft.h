@@ -0,0 +1,47 @@
+#ifndef _fft_h
+#define _fft_h
+
+/*
+ * Radix-2 complex FFT. Data is interleaved (re, im) doubles. Sizes must be
+ * powers of two. The inverse transform is not scaled by 1/n.
+ */
+typedef struct
+{
+    int n;
+    int *bit_reverse;
+    // cos and -sin of 2 pi k / n for k < n/2, interleaved
+    double *twiddle;
+    // n x n complex scratch for the transposes of fft_2d
+    double *scratch;
+} FftPlan;
+
+/*
+ * Function: fft_plan_create
+ * Usage: FftPlan *plan = fft_plan_create(1024);
+ * ---------------------------------------------
+ * Precomputes the tables for transforms of length n. Returns NULL if n is
+ * not a power of two.
+ */
+FftPlan *fft_plan_create(int n);
+
+/*
+ * Function: fft_1d
+ * Usage: fft_1d(plan, row, 0);
+ * ----------------------------
+ * Transforms n complex values in place. inverse = 1 uses exp(+i...).
+ */
+void fft_1d(const FftPlan *plan, double *data, int inverse);
+
+/*
+ * Function: fft_2d
+ * Usage: fft_2d(plan, grid, 0);
+ * -----------------------------
+ * Transforms an n x n row-major complex grid in place, as row transforms,
+ * a transpose, row transforms again and a transpose back, so every pass
+ * runs over contiguous memory.
+ */
+void fft_2d(FftPlan *plan, double *data, int inverse);
+
+void fft_plan_destroy(FftPlan *plan);
+
+#endif
@@ -0,0 +1,705 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "fmm.h"
+
+// Leaves hold at most this many particles, unless they are this deep
+#define LEAF_SIZE 32
+#define MAX_DEPTH 48
+#define MAX_COEFFICIENTS ((FMM_MAX_ORDER + 1) * (FMM_MAX_ORDER + 2) / 2)
+
+/*
+ * Tables shared by all solvers, filled by init_tables. Coefficient (a, b)
+ * of a multi-index with a + b = n is stored at n (n + 1) / 2 + b.
+ */
+static int tables_ready = 0;
+static double factorial[2 * FMM_MAX_ORDER + 2];
+static double binomial[FMM_MAX_ORDER + 1][FMM_MAX_ORDER + 1];
+// hermite[a][j] = a! / (2^j j! (a - 2j)!), the weight of x^(a-2j) in d^a/dx^a of F(x^2 / 2)
+static double hermite[FMM_MAX_ORDER + 1][FMM_MAX_ORDER / 2 + 1];
+// radial[m][i][j] is the coefficient of s^-i (s + eps)^-j in ((1/s) d/ds)^m psi(s)
+static double radial[FMM_MAX_ORDER + 1][2 * FMM_MAX_ORDER + 1][FMM_MAX_ORDER + 4];
+
+static int coefficient(int a, int b)
+{
+    return (a + b) * (a + b + 1) / 2 + b;
+}
+
+static void init_tables(void)
+{
+    if (tables_ready)
+    {
+        return;
+    }
+
+    factorial[0] = 1.0;
+    for (int n = 1; n < 2 * FMM_MAX_ORDER + 2; n++)
+    {
+        factorial[n] = factorial[n - 1] * n;
+    }
+    for (int n = 0; n <= FMM_MAX_ORDER; n++)
+    {
+        for (int k = 0; k <= n; k++)
+        {
+            binomial[n][k] = factorial[n] / (factorial[k] * factorial[n - k]);
+        }
+        for (int j = 0; 2 * j <= n; j++)
+        {
+            hermite[n][j] = factorial[n] / (ldexp(1.0, j) * factorial[j] * factorial[n - 2 * j]);
+        }
+    }
+
+    // (1/s) psi'(s) = -(s + eps)^-3, and (1/s) d/ds maps s^-i (s + eps)^-j to -i s^-(i+2) (s + eps)^-j - j s^-(i+1) (s + eps)^-(j+1)
+    memset(radial, 0, sizeof(radial));
+    radial[1][0][3] = -1.0;
+    for (int m = 1; m < FMM_MAX_ORDER; m++)
+    {
+        for (int i = 0; i <= 2 * m; i++)
+        {
+            for (int j = 0; j <= m + 2; j++)
+            {
+                double c = radial[m][i][j];
+                if (c != 0.0)
+                {
+                    radial[m + 1][i + 2][j] -= i * c;
+                    radial[m + 1][i + 1][j + 1] -= j * c;
+                }
+            }
+        }
+    }
+    tables_ready = 1;
+}
+
+/*
+ * Fills d[(a, b)] with the derivative d^(a+b) psi / dx^a dy^b at (x, y)
+ * for 1 <= a + b <= order. psi(s) is a function of u = s^2 / 2, and
+ * derivatives in u are the radial derivatives ((1/s) d/ds)^m psi.
+ */
+static void kernel_derivatives(double x, double y, double epsilon, int order, double *d)
+{
+    double s = sqrt(x * x + y * y);
+    double inv_s[2 * FMM_MAX_ORDER + 1], inv_se[FMM_MAX_ORDER + 4];
+    inv_s[0] = inv_se[0] = 1.0;
+    for (int i = 1; i <= 2 * order; i++)
+    {
+        inv_s[i] = inv_s[i - 1] / s;
+    }
+    for (int j = 1; j <= order + 3; j++)
+    {
+        inv_se[j] = inv_se[j - 1] / (s + epsilon);
+    }
+
+    double f[FMM_MAX_ORDER + 1];
+    for (int m = 1; m <= order; m++)
+    {
+        f[m] = 0.0;
+        for (int i = 0; i <= 2 * (m - 1); i++)
+        {
+            for (int j = 3; j <= m + 2; j++)
+            {
+                if (radial[m][i][j] != 0.0)
+                {
+                    f[m] += radial[m][i][j] * inv_s[i] * inv_se[j];
+                }
+            }
+        }
+    }
+
+    double xp[FMM_MAX_ORDER + 1], yp[FMM_MAX_ORDER + 1];
+    xp[0] = yp[0] = 1.0;
+    for (int n = 1; n <= order; n++)
+    {
+        xp[n] = xp[n - 1] * x;
+        yp[n] = yp[n - 1] * y;
+    }
+
+    d[0] = 0.0;
+    for (int n = 1; n <= order; n++)
+    {
+        for (int b = 0; b <= n; b++)
+        {
+            int a = n - b;
+            double sum = 0.0;
+            for (int ja = 0; 2 * ja <= a; ja++)
+            {
+                for (int jb = 0; 2 * jb <= b; jb++)
+                {
+                    sum += hermite[a][ja] * hermite[b][jb] * xp[a - 2 * ja] * yp[b - 2 * jb] * f[n - ja - jb];
+                }
+            }
+            d[coefficient(a, b)] = sum;
+        }
+    }
+}
+
+static int new_node(FmmSolver *fmm, int begin, int end)
+{
+    if (fmm->node_count == fmm->node_capacity)
+    {
+        fmm->node_capacity *= 2;
+        fmm->nodes = realloc(fmm->nodes, fmm->node_capacity * sizeof(FmmNode));
+    }
+    int n = fmm->node_count++;
+    FmmNode *node = &fmm->nodes[n];
+    node->begin = begin;
+    node->end = end;
+    node->child[0] = node->child[1] = node->child[2] = node->child[3] = -1;
+    return n;
+}
+
+static int is_leaf(const FmmNode *node)
+{
+    return node->child[0] == -1 && node->child[1] == -1 && node->child[2] == -1 && node->child[3] == -1;
+}
+
+// Splits index[begin..end) of the cell centred at (cx, cy) into its four quadrants
+static void build_node(FmmSolver *fmm, const Particles *particles, int n, double cx, double cy, double half, int depth)
+{
+    const int begin = fmm->nodes[n].begin;
+    const int end = fmm->nodes[n].end;
+    if (end - begin <= fmm->leaf_size || depth >= MAX_DEPTH)
+    {
+        return;
+    }
+
+    // Counting sort by quadrant through the scratch array
+    int count[4] = {0, 0, 0, 0};
+    for (int k = begin; k < end; k++)
+    {
+        int i = fmm->index[k];
+        int q = (particles->posx[i] >= cx) + 2 * (particles->posy[i] >= cy);
+        fmm->scratch[k] = q;
+        count[q]++;
+    }
+    int start[4];
+    start[0] = begin;
+    for (int q = 1; q < 4; q++)
+    {
+        start[q] = start[q - 1] + count[q - 1];
+    }
+    int fill[4] = {start[0], start[1], start[2], start[3]};
+    int *sorted = fmm->scratch + fmm->N;
+    for (int k = begin; k < end; k++)
+    {
+        sorted[fill[fmm->scratch[k]]++] = fmm->index[k];
+    }
+    memcpy(fmm->index + begin, sorted + begin, (end - begin) * sizeof(int));
+
+    for (int q = 0; q < 4; q++)
+    {
+        if (count[q] > 0)
+        {
+            int c = new_node(fmm, start[q], start[q] + count[q]);
+            fmm->nodes[n].child[q] = c;
+            double h = 0.5 * half;
+            build_node(fmm, particles, c, cx + ((q & 1) ? h : -h), cy + ((q & 2) ? h : -h), h, depth + 1);
+        }
+    }
+}
+
+static void build_tree(FmmSolver *fmm, const Particles *particles)
+{
+    const int N = fmm->N;
+    double min_x = particles->posx[0], max_x = particles->posx[0];
+    double min_y = particles->posy[0], max_y = particles->posy[0];
+    for (int i = 0; i < N; i++)
+    {
+        fmm->index[i] = i;
+        min_x = fmin(min_x, particles->posx[i]);
+        max_x = fmax(max_x, particles->posx[i]);
+        min_y = fmin(min_y, particles->posy[i]);
+        max_y = fmax(max_y, particles->posy[i]);
+    }
+    double half = 0.5 * fmax(max_x - min_x, max_y - min_y);
+    half = half * (1.0 + 1e-12) + 1e-300;
+
+    fmm->node_count = 0;
+    int root = new_node(fmm, 0, N);
+    build_node(fmm, particles, root, 0.5 * (min_x + max_x), 0.5 * (min_y + max_y), half, 0);
+
+    for (int k = 0; k < N; k++)
+    {
+        int i = fmm->index[k];
+        fmm->sx[k] = particles->posx[i];
+        fmm->sy[k] = particles->posy[i];
+        fmm->sm[k] = particles->mass[i];
+    }
+}
+
+// Picks subtrees for the threads by repeatedly splitting the one with the most particles
+static void choose_frontier(FmmSolver *fmm, int target)
+{
+    fmm->frontier_count = 0;
+    fmm->top_count = 0;
+    fmm->frontier[fmm->frontier_count++] = 0;
+    while (fmm->frontier_count < target)
+    {
+        int largest = -1;
+        for (int k = 0; k < fmm->frontier_count; k++)
+        {
+            const FmmNode *node = &fmm->nodes[fmm->frontier[k]];
+            if (!is_leaf(node) && (largest == -1 ||
+                node->end - node->begin > fmm->nodes[fmm->frontier[largest]].end - fmm->nodes[fmm->frontier[largest]].begin))
+            {
+                largest = k;
+            }
+        }
+        if (largest == -1)
+        {
+            break;
+        }
+
+        int n = fmm->frontier[largest];
+        fmm->top[fmm->top_count++] = n;
+        fmm->frontier[largest] = fmm->frontier[--fmm->frontier_count];
+        for (int q = 0; q < 4; q++)
+        {
+            if (fmm->nodes[n].child[q] != -1)
+            {
+                fmm->frontier[fmm->frontier_count++] = fmm->nodes[n].child[q];
+            }
+        }
+    }
+}
+
+// Moments about the centre of mass of the particles of a leaf
+static void particles_to_multipole(FmmSolver *fmm, FmmNode *node, double *q)
+{
+    const int p = fmm->order;
+    double m = 0.0, mx = 0.0, my = 0.0;
+    for (int k = node->begin; k < node->end; k++)
+    {
+        m += fmm->sm[k];
+        mx += fmm->sm[k] * fmm->sx[k];
+        my += fmm->sm[k] * fmm->sy[k];
+    }
+    node->mass = m;
+    node->zx = m > 0.0 ? mx / m : fmm->sx[node->begin];
+    node->zy = m > 0.0 ? my / m : fmm->sy[node->begin];
+    node->radius = 0.0;
+
+    memset(q, 0, fmm->coefficient_count * sizeof(double));
+    for (int k = node->begin; k < node->end; k++)
+    {
+        double dx = fmm->sx[k] - node->zx;
+        double dy = fmm->sy[k] - node->zy;
+        node->radius = fmax(node->radius, sqrt(dx * dx + dy * dy));
+
+        double xp[FMM_MAX_ORDER + 1], yp[FMM_MAX_ORDER + 1];
+        xp[0] = yp[0] = 1.0;
+        for (int n = 1; n <= p; n++)
+        {
+            xp[n] = xp[n - 1] * dx;
+            yp[n] = yp[n - 1] * dy;
+        }
+        for (int n = 0; n <= p; n++)
+        {
+            for (int b = 0; b <= n; b++)
+            {
+                q[coefficient(n - b, b)] += fmm->sm[k] * xp[n - b] * yp[b];
+            }
+        }
+    }
+}
+
+// Shifts the children's moments to the centre of mass of the node
+static void multipole_to_multipole(FmmSolver *fmm, FmmNode *node, double *q)
+{
+    const int p = fmm->order;
+    double m = 0.0, mx = 0.0, my = 0.0;
+    for (int c = 0; c < 4; c++)
+    {
+        if (node->child[c] != -1)
+        {
+            const FmmNode *child = &fmm->nodes[node->child[c]];
+            m += child->mass;
+            mx += child->mass * child->zx;
+            my += child->mass * child->zy;
+        }
+    }
+    node->mass = m;
+    node->zx = m > 0.0 ? mx / m : fmm->sx[node->begin];
+    node->zy = m > 0.0 ? my / m : fmm->sy[node->begin];
+    node->radius = 0.0;
+
+    memset(q, 0, fmm->coefficient_count * sizeof(double));
+    for (int c = 0; c < 4; c++)
+    {
+        if (node->child[c] == -1)
+        {
+            continue;
+        }
+        const FmmNode *child = &fmm->nodes[node->child[c]];
+        const double *qc = fmm->multipole + (size_t)node->child[c] * fmm->coefficient_count;
+        double tx = child->zx - node->zx;
+        double ty = child->zy - node->zy;
+        node->radius = fmax(node->radius, sqrt(tx * tx + ty * ty) + child->radius);
+
+        double xp[FMM_MAX_ORDER + 1], yp[FMM_MAX_ORDER + 1];
+        xp[0] = yp[0] = 1.0;
+        for (int n = 1; n <= p; n++)
+        {
+            xp[n] = xp[n - 1] * tx;
+            yp[n] = yp[n - 1] * ty;
+        }
+        for (int n = 0; n <= p; n++)
+        {
+            for (int b = 0; b <= n; b++)
+            {
+                int a = n - b;
+                double sum = 0.0;
+                for (int ja = 0; ja <= a; ja++)
+                {
+                    for (int jb = 0; jb <= b; jb++)
+                    {
+                        sum += binomial[a][ja] * binomial[b][jb] * qc[coefficient(ja, jb)] * xp[a - ja] * yp[b - jb];
+                    }
+                }
+                q[coefficient(a, b)] += sum;
+            }
+        }
+    }
+}
+
+static void upward(FmmSolver *fmm, int n)
+{
+    FmmNode *node = &fmm->nodes[n];
+    double *q = fmm->multipole + (size_t)n * fmm->coefficient_count;
+    if (is_leaf(node))
+    {
+        particles_to_multipole(fmm, node, q);
+        return;
+    }
+    for (int c = 0; c < 4; c++)
+    {
+        if (node->child[c] != -1)
+        {
+            upward(fmm, node->child[c]);
+        }
+    }
+    multipole_to_multipole(fmm, node, q);
+}
+
+// Adds the field of source cell b, through its moments, to the local expansion of target cell a
+static void multipole_to_local(FmmSolver *fmm, const FmmNode *a, const FmmNode *b, double *local, const double *q)
+{
+    const int p = fmm->order;
+    double d[MAX_COEFFICIENTS];
+    kernel_derivatives(a->zx - b->zx, a->zy - b->zy, fmm->epsilon, p, d);
+
+    // Lambda_k = sum_n (-1)^|n| / n! Q_n D^(n+k) psi; the potential term k = 0 is not needed for forces
+    for (int kn = 1; kn <= p; kn++)
+    {
+        for (int kb = 0; kb <= kn; kb++)
+        {
+            int ka = kn - kb;
+            double sum = 0.0;
+            for (int n = 0; n + kn <= p; n++)
+            {
+                double sign = (n & 1) ? -1.0 : 1.0;
+                for (int nb = 0; nb <= n; nb++)
+                {
+                    int na = n - nb;
+                    sum += sign * q[coefficient(na, nb)] / (factorial[na] * factorial[nb]) *
+                           d[coefficient(na + ka, nb + kb)];
+                }
+            }
+            local[coefficient(ka, kb)] += sum;
+        }
+    }
+}
+
+// Direct sum of the particles of source leaf b onto the particles of target leaf a
+static void particle_to_particle(FmmSolver *fmm, const FmmNode *a, const FmmNode *b)
+{
+    const double epsilon = fmm->epsilon;
+    for (int i = a->begin; i < a->end; i++)
+    {
+        const double xi = fmm->sx[i];
+        const double yi = fmm->sy[i];
+        double aXi = 0.0, aYi = 0.0;
+        for (int j = b->begin; j < b->end; j++)
+        {
+            double rx = xi - fmm->sx[j];
+            double ry = yi - fmm->sy[j];
+            double rr = sqrt(rx * rx + ry * ry) + epsilon;
+            double div_1_rr = fmm->sm[j] / (rr * rr * rr);
+            aXi += rx * div_1_rr;
+            aYi += ry * div_1_rr;
+        }
+        fmm->sax[i] += aXi;
+        fmm->say[i] += aYi;
+    }
+}
+
+// Dual tree walk: everything in source cell b acting on everything in target cell a
+static void interact(FmmSolver *fmm, int ia, int ib)
+{
+    const FmmNode *a = &fmm->nodes[ia];
+    const FmmNode *b = &fmm->nodes[ib];
+    double rx = a->zx - b->zx;
+    double ry = a->zy - b->zy;
+    double reach = a->radius + b->radius;
+
+    if (ia != ib && reach * reach < fmm->theta * fmm->theta * (rx * rx + ry * ry))
+    {
+        multipole_to_local(fmm, a, b, fmm->local + (size_t)ia * fmm->coefficient_count,
+                           fmm->multipole + (size_t)ib * fmm->coefficient_count);
+        return;
+    }
+
+    int a_leaf = is_leaf(a);
+    int b_leaf = is_leaf(b);
+    if (a_leaf && b_leaf)
+    {
+        particle_to_particle(fmm, a, b);
+    }
+    else if (b_leaf || (!a_leaf && a->radius >= b->radius))
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            if (a->child[c] != -1)
+            {
+                interact(fmm, a->child[c], ib);
+            }
+        }
+    }
+    else
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            if (b->child[c] != -1)
+            {
+                interact(fmm, ia, b->child[c]);
+            }
+        }
+    }
+}
+
+// Shifts the local expansion of a node to the centre of one of its children and adds it there
+static void local_to_local(FmmSolver *fmm, const FmmNode *node, const double *local, const FmmNode *child, double *child_local)
+{
+    const int p = fmm->order;
+    double tx = child->zx - node->zx;
+    double ty = child->zy - node->zy;
+    double xp[FMM_MAX_ORDER + 1], yp[FMM_MAX_ORDER + 1];
+    xp[0] = yp[0] = 1.0;
+    for (int n = 1; n <= p; n++)
+    {
+        xp[n] = xp[n - 1] * tx;
+        yp[n] = yp[n - 1] * ty;
+    }
+
+    for (int kn = 1; kn <= p; kn++)
+    {
+        for (int kb = 0; kb <= kn; kb++)
+        {
+            int ka = kn - kb;
+            double sum = 0.0;
+            for (int n = 0; n + kn <= p; n++)
+            {
+                for (int nb = 0; nb <= n; nb++)
+                {
+                    int na = n - nb;
+                    sum += local[coefficient(ka + na, kb + nb)] * xp[na] * yp[nb] / (factorial[na] * factorial[nb]);
+                }
+            }
+            child_local[coefficient(ka, kb)] += sum;
+        }
+    }
+}
+
+// Evaluates minus the gradient of the local expansion at every particle of a leaf
+static void local_to_particles(FmmSolver *fmm, const FmmNode *node, const double *local)
+{
+    const int p = fmm->order;
+    for (int i = node->begin; i < node->end; i++)
+    {
+        double ex = fmm->sx[i] - node->zx;
+        double ey = fmm->sy[i] - node->zy;
+        double xp[FMM_MAX_ORDER + 1], yp[FMM_MAX_ORDER + 1];
+        xp[0] = yp[0] = 1.0;
+        for (int n = 1; n <= p; n++)
+        {
+            xp[n] = xp[n - 1] * ex;
+            yp[n] = yp[n - 1] * ey;
+        }
+
+        double gx = 0.0, gy = 0.0;
+        for (int n = 0; n < p; n++)
+        {
+            for (int b = 0; b <= n; b++)
+            {
+                int a = n - b;
+                double w = xp[a] * yp[b] / (factorial[a] * factorial[b]);
+                gx += local[coefficient(a + 1, b)] * w;
+                gy += local[coefficient(a, b + 1)] * w;
+            }
+        }
+        fmm->sax[i] -= gx;
+        fmm->say[i] -= gy;
+    }
+}
+
+static void downward(FmmSolver *fmm, int n)
+{
+    const FmmNode *node = &fmm->nodes[n];
+    const double *local = fmm->local + (size_t)n * fmm->coefficient_count;
+    if (is_leaf(node))
+    {
+        local_to_particles(fmm, node, local);
+        return;
+    }
+    for (int c = 0; c < 4; c++)
+    {
+        if (node->child[c] != -1)
+        {
+            local_to_local(fmm, node, local, &fmm->nodes[node->child[c]],
+                           fmm->local + (size_t)node->child[c] * fmm->coefficient_count);
+            downward(fmm, node->child[c]);
+        }
+    }
+}
+
+// Hands out frontier subtrees until none are left, so uneven subtrees balance out
+static int next_subtree(FmmSolver *fmm)
+{
+    int k = __sync_fetch_and_add(&fmm->next_task, 1);
+    return k < fmm->frontier_count ? fmm->frontier[k] : -1;
+}
+
+static void *upward_task(void *arg)
+{
+    FmmSolver *fmm = *(FmmSolver **)arg;
+    for (int n = next_subtree(fmm); n != -1; n = next_subtree(fmm))
+    {
+        upward(fmm, n);
+    }
+    return NULL;
+}
+
+static void *interact_task(void *arg)
+{
+    FmmSolver *fmm = *(FmmSolver **)arg;
+    for (int n = next_subtree(fmm); n != -1; n = next_subtree(fmm))
+    {
+        // Each thread only writes to the locals and particles of its own target subtrees
+        interact(fmm, n, 0);
+    }
+    return NULL;
+}
+
+static void *downward_task(void *arg)
+{
+    FmmSolver *fmm = *(FmmSolver **)arg;
+    for (int n = next_subtree(fmm); n != -1; n = next_subtree(fmm))
+    {
+        downward(fmm, n);
+    }
+    return NULL;
+}
+
+static void run_phase(FmmSolver *fmm, void *(*task)(void *))
+{
+    FmmSolver *args[fmm->pool->thread_count];
+    for (int t = 0; t < fmm->pool->thread_count; t++)
+    {
+        args[t] = fmm;
+    }
+    fmm->next_task = 0;
+    pool_run(fmm->pool, task, args, sizeof(FmmSolver *));
+}
+
+FmmSolver *fmm_create(int N, int order, double theta, double epsilon, int thread_count)
+{
+    if (order < 1 || order > FMM_MAX_ORDER)
+    {
+        printf("The FMM order must be between 1 and %d.\n", FMM_MAX_ORDER);
+        return NULL;
+    }
+    init_tables();
+
+    FmmSolver *fmm = malloc(sizeof(FmmSolver));
+    fmm->N = N;
+    fmm->order = order;
+    fmm->leaf_size = LEAF_SIZE;
+    fmm->theta = theta;
+    fmm->epsilon = epsilon;
+    fmm->node_capacity = 2 * (N / LEAF_SIZE + 1) + 16;
+    fmm->node_count = 0;
+    fmm->nodes = malloc(fmm->node_capacity * sizeof(FmmNode));
+    fmm->index = malloc(N * sizeof(int));
+    fmm->scratch = malloc(2 * (size_t)N * sizeof(int));
+    fmm->sx = malloc(N * sizeof(double));
+    fmm->sy = malloc(N * sizeof(double));
+    fmm->sm = malloc(N * sizeof(double));
+    fmm->sax = malloc(N * sizeof(double));
+    fmm->say = malloc(N * sizeof(double));
+    fmm->coefficient_count = (order + 1) * (order + 2) / 2;
+    fmm->multipole = NULL;
+    fmm->local = NULL;
+    fmm->frontier = NULL;
+    fmm->top = NULL;
+    fmm->pool = pool_create(thread_count > 0 ? thread_count : 1);
+    return fmm;
+}
+
+void update_acceleration_fmm(FmmSolver *fmm, Particles *particles)
+{
+    const int N = fmm->N;
+    if (N == 0)
+    {
+        return;
+    }
+
+    build_tree(fmm, particles);
+    fmm->multipole = realloc(fmm->multipole, (size_t)fmm->node_count * fmm->coefficient_count * sizeof(double));
+    fmm->local = realloc(fmm->local, (size_t)fmm->node_count * fmm->coefficient_count * sizeof(double));
+    memset(fmm->local, 0, (size_t)fmm->node_count * fmm->coefficient_count * sizeof(double));
+    memset(fmm->sax, 0, N * sizeof(double));
+    memset(fmm->say, 0, N * sizeof(double));
+
+    // A few subtrees per thread, so the dynamic hand-out can even out the load
+    fmm->frontier = realloc(fmm->frontier, fmm->node_count * sizeof(int));
+    fmm->top = realloc(fmm->top, fmm->node_count * sizeof(int));
+    choose_frontier(fmm, fmm->pool->thread_count == 1 ? 1 : 8 * fmm->pool->thread_count);
+
+    // Upward pass: subtrees in parallel, then the few nodes above them, children before parents
+    run_phase(fmm, upward_task);
+    for (int k = fmm->top_count - 1; k >= 0; k--)
+    {
+        int n = fmm->top[k];
+        multipole_to_multipole(fmm, &fmm->nodes[n], fmm->multipole + (size_t)n * fmm->coefficient_count);
+    }
+
+    run_phase(fmm, interact_task);
+
+    // Targets are only ever split downwards from the subtrees, so the nodes above them have no local terms
+    run_phase(fmm, downward_task);
+
+    for (int k = 0; k < N; k++)
+    {
+        int i = fmm->index[k];
+        particles->accx[i] = fmm->sax[k];
+        particles->accy[i] = fmm->say[k];
+    }
+}
+
+void fmm_destroy(FmmSolver *fmm)
+{
+    pool_destroy(fmm->pool);
+    free(fmm->nodes);
+    free(fmm->index);
+    free(fmm->scratch);
+    free(fmm->sx);
+    free(fmm->sy);
+    free(fmm->sm);
+    free(fmm->sax);
+    free(fmm->say);
+    free(fmm->multipole);
+    free(fmm->local);
+    free(fmm->frontier);
+    free(fmm->top);
+    free(fmm);
+}
@@ -0,0 +1,89 @@
+#ifndef _fmm_h
+#define _fmm_h
+
+#include "particles.h"
+#include "thread_pool.h"
+
+#define FMM_MAX_ORDER 16
+
+/*
+ * Fast multipole solver for the softened force of the other kernels,
+ * sum_j m_j * r_ij / (|r_ij| + epsilon)^3. That force is minus the
+ * gradient of the radial potential psi(s) = 1/(s + eps) - eps/(2 (s + eps)^2).
+ * Because psi is not harmonic in 2D, the expansions are Cartesian Taylor
+ * series in (x, y) up to total order p rather than complex power series.
+ * Cells are paired by a dual tree walk. Two cells with
+ * r_A + r_B < theta * |z_A - z_B| interact through their expansions,
+ * and leaf pairs that fail the test interact directly.
+ */
+typedef struct
+{
+    // Expansion centre (centre of mass) and radius of the particles around it
+    double zx;
+    double zy;
+    double radius;
+    double mass;
+    // Particles begin..end-1 of the sorted arrays
+    int begin;
+    int end;
+    int child[4];
+} FmmNode;
+
+typedef struct
+{
+    int N;
+    int order;
+    int leaf_size;
+    double theta;
+    double epsilon;
+
+    FmmNode *nodes;
+    int node_count;
+    int node_capacity;
+
+    // Particles in tree order, the sorted arrays are indexed by position in "index"
+    int *index;
+    int *scratch;
+    double *sx;
+    double *sy;
+    double *sm;
+    double *sax;
+    double *say;
+
+    // Multipole and local coefficients, coefficient_count per node
+    int coefficient_count;
+    double *multipole;
+    double *local;
+
+    // Subtrees handed out to threads, and the nodes above them in breadth-first order
+    int *frontier;
+    int frontier_count;
+    int *top;
+    int top_count;
+    int next_task;
+
+    ThreadPool *pool;
+} FmmSolver;
+
+/*
+ * Function: fmm_create
+ * Usage: FmmSolver *fmm = fmm_create(N, 6, 0.5, epsilon, thread_count);
+ * ---------------------------------------------------------------------
+ * Sets up a solver for N particles with expansions of the given order
+ * (1..FMM_MAX_ORDER) and opening parameter theta. The upward pass, the
+ * cell interactions and the downward pass run on a pool of thread_count
+ * threads. Returns NULL for an unsupported order.
+ */
+FmmSolver *fmm_create(int N, int order, double theta, double epsilon, int thread_count);
+
+/*
+ * Function: update_acceleration_fmm
+ * Usage: update_acceleration_fmm(fmm, particles);
+ * -----------------------------------------------
+ * Rebuilds the tree from the current positions and fills accx/accy.
+ */
+void update_acceleration_fmm(FmmSolver *fmm, Particles *particles);
+
+void fmm_destroy(FmmSolver *fmm);
+
+#endif
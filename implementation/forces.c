@@ -0,0 +1,217 @@
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "forces.h"
+#include "tiled_kernel.h"
+
+static const char *kernel_names[FORCE_KERNEL_COUNT] = {"direct", "symmetric", "simd", "tiled",
+                                                       "mixed", "barnes-hut", "fmm", "pm"};
+
+int force_kernel_from_name(const char *name)
+{
+    for (int k = 0; k < FORCE_KERNEL_COUNT; k++)
+    {
+        if (strcmp(name, kernel_names[k]) == 0)
+        {
+            return k;
+        }
+    }
+    return -1;
+}
+
+const char *force_kernel_name(ForceKernel kind)
+{
+    return kind >= 0 && kind < FORCE_KERNEL_COUNT ? kernel_names[kind] : "unknown";
+}
+
+// Plain direct sum over all j != i
+static void update_acceleration_direct(Particles *particles, int N, double epsilon)
+{
+    for (int i = 0; i < N; i++)
+    {
+        double ax = 0.0, ay = 0.0;
+        for (int j = 0; j < N; j++)
+        {
+            if (i != j)
+            {
+                double rx = particles->posx[i] - particles->posx[j];
+                double ry = particles->posy[i] - particles->posy[j];
+                double rr = sqrt(rx * rx + ry * ry) + epsilon;
+                double div_1_rr = 1 / (rr * rr * rr);
+                ax += particles->mass[j] * rx * div_1_rr;
+                ay += particles->mass[j] * ry * div_1_rr;
+            }
+        }
+        particles->accx[i] = ax;
+        particles->accy[i] = ay;
+    }
+}
+
+// Every pair once, the term for j is the opposite of the one for i
+static void update_acceleration_symmetric(Particles *particles, int N, double epsilon)
+{
+    memset(particles->accx, 0, N * sizeof(double));
+    memset(particles->accy, 0, N * sizeof(double));
+    for (int i = 0; i < N; i++)
+    {
+        double ax = 0.0, ay = 0.0;
+        for (int j = i + 1; j < N; j++)
+        {
+            double rx = particles->posx[i] - particles->posx[j];
+            double ry = particles->posy[i] - particles->posy[j];
+            double rr = sqrt(rx * rx + ry * ry) + epsilon;
+            double div_1_rr = 1 / (rr * rr * rr);
+            double rx_div = rx * div_1_rr;
+            double ry_div = ry * div_1_rr;
+            ax += particles->mass[j] * rx_div;
+            ay += particles->mass[j] * ry_div;
+            particles->accx[j] -= particles->mass[i] * rx_div;
+            particles->accy[j] -= particles->mass[i] * ry_div;
+        }
+        particles->accx[i] += ax;
+        particles->accy[i] += ay;
+    }
+}
+
+int force_method_init(ForceMethod *forces, ForceKernel kind, const Particles *particles, int N, double epsilon,
+                      double theta, int fmm_order, int fmm_threads, int pm_grid)
+{
+    memset(forces, 0, sizeof(ForceMethod));
+    forces->kind = kind;
+    forces->name = force_kernel_name(kind);
+    forces->N = N;
+    forces->theta = theta;
+    forces->epsilon = epsilon;
+
+    switch (kind)
+    {
+    case FORCE_SIMD:
+        forces->kernel = select_acceleration_kernel(&forces->name);
+        break;
+    case FORCE_TILED:
+        forces->block = select_acceleration_block_kernel(&forces->name);
+        break;
+    case FORCE_MIXED:
+        forces->mixed = select_mixed_kernel(&forces->name);
+        forces->fparticles = float_particles_create(particles, N);
+        break;
+    case FORCE_BARNES_HUT:
+        forces->tree = quadtree_create(N);
+        break;
+    case FORCE_FMM:
+        forces->fmm = fmm_create(N, fmm_order, theta, epsilon, fmm_threads);
+        return forces->fmm != NULL ? 0 : -1;
+    case FORCE_PM:
+        forces->pm = pm_create(particles, N, pm_grid, epsilon);
+        return forces->pm != NULL ? 0 : -1;
+    case FORCE_DIRECT:
+    case FORCE_SYMMETRIC:
+        break;
+    default:
+        return -1;
+    }
+    return 0;
+}
+
+void compute_forces(ForceMethod *forces, Particles *particles)
+{
+    switch (forces->kind)
+    {
+    case FORCE_DIRECT:
+        update_acceleration_direct(particles, forces->N, forces->epsilon);
+        break;
+    case FORCE_SYMMETRIC:
+        update_acceleration_symmetric(particles, forces->N, forces->epsilon);
+        break;
+    case FORCE_SIMD:
+        forces->kernel(particles, forces->N, forces->epsilon);
+        break;
+    case FORCE_TILED:
+        update_acceleration_tiled(forces->block, particles, forces->N, forces->epsilon);
+        break;
+    case FORCE_MIXED:
+        float_particles_update(forces->fparticles, particles);
+        forces->mixed(forces->fparticles, particles, forces->epsilon);
+        break;
+    case FORCE_BARNES_HUT:
+        quadtree_build(forces->tree, particles);
+        update_acceleration_bh(forces->tree, particles, forces->theta, forces->epsilon);
+        break;
+    case FORCE_FMM:
+        update_acceleration_fmm(forces->fmm, particles);
+        break;
+    case FORCE_PM:
+        update_acceleration_pm(forces->pm, particles);
+        break;
+    default:
+        break;
+    }
+}
+
+void force_method_release(ForceMethod *forces)
+{
+    if (forces->fmm != NULL)
+    {
+        fmm_destroy(forces->fmm);
+    }
+    if (forces->pm != NULL)
+    {
+        pm_destroy(forces->pm);
+    }
+    if (forces->tree != NULL)
+    {
+        quadtree_destroy(forces->tree);
+    }
+    if (forces->fparticles != NULL)
+    {
+        float_particles_destroy(forces->fparticles);
+    }
+}
+
+static double monotonic_seconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+ForceKernel force_kernel_calibrate(Particles *particles, int N, double epsilon, double *seconds)
+{
+    static const ForceKernel candidates[] = {FORCE_DIRECT, FORCE_SYMMETRIC, FORCE_SIMD, FORCE_TILED};
+    ForceKernel best = FORCE_SIMD;
+    double best_seconds = -1.0;
+    if (seconds != NULL)
+    {
+        for (int k = 0; k < FORCE_KERNEL_COUNT; k++)
+        {
+            seconds[k] = -1.0;
+        }
+    }
+
+    for (size_t c = 0; c < sizeof(candidates) / sizeof(candidates[0]); c++)
+    {
+        ForceMethod forces;
+        force_method_init(&forces, candidates[c], particles, N, epsilon, 0.0, 0, 1, 0);
+        double fastest = -1.0, spent = 0.0;
+        for (int call = 0; call < CALIBRATION_CALLS && spent < CALIBRATION_SECONDS; call++)
+        {
+            double start = monotonic_seconds();
+            compute_forces(&forces, particles);
+            double elapsed = monotonic_seconds() - start;
+            fastest = fastest < 0.0 || elapsed < fastest ? elapsed : fastest;
+            spent += elapsed;
+        }
+        force_method_release(&forces);
+
+        if (seconds != NULL)
+        {
+            seconds[candidates[c]] = fastest;
+        }
+        if (best_seconds < 0.0 || fastest < best_seconds)
+        {
+            best = candidates[c];
+            best_seconds = fastest;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,106 @@
+#ifndef _forces_h
+#define _forces_h
+
+#include "particles.h"
+#include "barnes_hut.h"
+#include "simd_kernel.h"
+#include "mixed_kernel.h"
+#include "fmm.h"
+#include "pm.h"
+
+/*
+ * The force evaluations that can be chosen at run time. The first five
+ * are exact direct sums (the --kernel choices of galsim), the others
+ * approximate the sum with a tree, multipoles or a mesh.
+ */
+typedef enum
+{
+    FORCE_DIRECT,
+    FORCE_SYMMETRIC,
+    FORCE_SIMD,
+    FORCE_TILED,
+    FORCE_MIXED,
+    FORCE_BARNES_HUT,
+    FORCE_FMM,
+    FORCE_PM,
+    FORCE_KERNEL_COUNT
+} ForceKernel;
+
+/*
+ * One force evaluation with its state. name is the kernel name, or the
+ * instruction set chosen by CPUID for simd, tiled and mixed.
+ */
+typedef struct
+{
+    ForceKernel kind;
+    const char *name;
+    int N;
+    double theta;
+    double epsilon;
+    QuadTree *tree;
+    FmmSolver *fmm;
+    PmSolver *pm;
+    AccelerationKernel kernel;
+    AccelerationBlockKernel block;
+    MixedAccelerationKernel mixed;
+    FloatParticles *fparticles;
+} ForceMethod;
+
+/*
+ * Function: force_kernel_from_name
+ * Usage: int kind = force_kernel_from_name("tiled");
+ * --------------------------------------------------
+ * Maps direct, symmetric, simd, tiled, mixed, barnes-hut, fmm or pm to
+ * its ForceKernel. Returns -1 for any other name.
+ */
+int force_kernel_from_name(const char *name);
+
+/*
+ * Function: force_kernel_name
+ * Usage: printf("%s\n", force_kernel_name(FORCE_SIMD));
+ * -----------------------------------------------------
+ * The name force_kernel_from_name accepts for kind.
+ */
+const char *force_kernel_name(ForceKernel kind);
+
+/*
+ * Function: force_method_init
+ * Usage: force_method_init(&forces, FORCE_FMM, particles, N, epsilon, theta, 6, threads, 0);
+ * ------------------------------------------------------------------------------------------
+ * Sets up kind for N particles. theta is used by barnes-hut and fmm,
+ * fmm_order and fmm_threads by fmm, and pm_grid by pm (0 picks the grid
+ * from epsilon). Returns 0 on success and -1 if the solver could not be
+ * created, in which case nothing needs to be released.
+ */
+int force_method_init(ForceMethod *forces, ForceKernel kind, const Particles *particles, int N, double epsilon,
+                      double theta, int fmm_order, int fmm_threads, int pm_grid);
+
+/*
+ * Function: compute_forces
+ * Usage: compute_forces(&forces, particles);
+ * ------------------------------------------
+ * Fills accx/accy with sum_j m_j * r_ij / (|r_ij| + epsilon)^3, or its
+ * approximation, for the current positions.
+ */
+void compute_forces(ForceMethod *forces, Particles *particles);
+
+void force_method_release(ForceMethod *forces);
+
+/*
+ * Function: force_kernel_calibrate
+ * Usage: ForceKernel kind = force_kernel_calibrate(particles, N, epsilon, seconds);
+ * ---------------------------------------------------------------------------------
+ * Times compute_forces for direct, symmetric, simd and tiled on the given
+ * particles and returns the fastest. mixed and the approximate methods are
+ * not candidates because they change the results. Each kernel runs until
+ * it has used CALIBRATION_SECONDS or CALIBRATION_CALLS calls, and the
+ * best call counts. Only accx/accy are overwritten. If seconds is not NULL
+ * it receives the time per call of every candidate, indexed by kind, and
+ * a negative value for the others.
+ */
+ForceKernel force_kernel_calibrate(Particles *particles, int N, double epsilon, double *seconds);
+
+#define CALIBRATION_SECONDS 0.05
+#define CALIBRATION_CALLS 5
+
+#endif
@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "gal_io.h"
+#include "galsnap.h"
+#include "arena.h"
+
+#define FIELDS_PER_PARTICLE 6
+#define ARRAY_COUNT 8
+
+// Files smaller than this are read or written by the calling thread alone
+#define PARALLEL_LOAD_BYTES (64UL << 20)
+#define MAX_LOAD_THREADS 8
+
+// Particles interleaved per pwrite call
+#define WRITE_CHUNK_PARTICLES 65536
+
+typedef struct
+{
+    const double *buffer;
+    Particles *particles;
+    int start_n;
+    int end_n;
+} LoadInput;
+
+typedef struct
+{
+    const Particles *particles;
+    int fd;
+    int start_n;
+    int end_n;
+    int status;
+} SaveInput;
+
+static int io_thread_count(size_t bytes)
+{
+    if (bytes < PARALLEL_LOAD_BYTES)
+    {
+        return 1;
+    }
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus < 1 ? 1 : (cpus > MAX_LOAD_THREADS ? MAX_LOAD_THREADS : (int)cpus);
+}
+
+// Scratch space and page size for the particle arenas, see set_particle_arena
+static size_t arena_scratch_bytes = 0;
+static int arena_huge_pages = 0;
+
+void set_particle_arena(size_t scratch_bytes, int huge_pages)
+{
+    arena_scratch_bytes = scratch_bytes;
+    arena_huge_pages = huge_pages;
+}
+
+Arena *particle_arena_create(int particle_count, int array_count)
+{
+    size_t array_bytes = arena_bytes((size_t)particle_count * sizeof(double));
+    return arena_create(array_count * array_bytes + arena_scratch_bytes, arena_huge_pages);
+}
+
+Particles *alloc_particles(int particle_count)
+{
+    Arena *arena = particle_arena_create(particle_count, ARRAY_COUNT);
+    if (arena == NULL)
+    {
+        return NULL;
+    }
+    size_t bytes = (size_t)particle_count * sizeof(double);
+    Particles *particles = malloc(sizeof(Particles));
+    particles->posx = arena_alloc(arena, bytes);
+    particles->posy = arena_alloc(arena, bytes);
+    particles->mass = arena_alloc(arena, bytes);
+    particles->velx = arena_alloc(arena, bytes);
+    particles->vely = arena_alloc(arena, bytes);
+    particles->accx = arena_alloc(arena, bytes);
+    particles->accy = arena_alloc(arena, bytes);
+    particles->brightness = arena_alloc(arena, bytes);
+    particles->mapping = NULL;
+    particles->mapping_bytes = 0;
+    particles->arena = arena;
+    return particles;
+}
+
+static void *deinterleave(void *arg)
+{
+    LoadInput *input = (LoadInput *)arg;
+    const double *buffer = input->buffer;
+    Particles *particles = input->particles;
+
+    for (int i = input->start_n; i < input->end_n; i++)
+    {
+        particles->posx[i] = buffer[(6 * (size_t)i) + 0];
+        particles->posy[i] = buffer[(6 * (size_t)i) + 1];
+        particles->mass[i] = buffer[(6 * (size_t)i) + 2];
+        particles->velx[i] = buffer[(6 * (size_t)i) + 3];
+        particles->vely[i] = buffer[(6 * (size_t)i) + 4];
+        particles->brightness[i] = buffer[(6 * (size_t)i) + 5];
+        particles->accx[i] = 0.0;
+        particles->accy[i] = 0.0;
+    }
+
+    return NULL;
+}
+
+Particles *read_data_v2(int particle_count, const char *filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        printf("read_doubles_from_file error: failed to open input file '%s'.\n", filename);
+        return NULL;
+    }
+
+    struct stat st;
+    size_t expectedSize = (size_t)FIELDS_PER_PARTICLE * particle_count * sizeof(double);
+    if (fstat(fd, &st) != 0)
+    {
+        st.st_size = 0;
+    }
+    if ((size_t)st.st_size != expectedSize)
+    {
+        printf("read_doubles_from_file error: size of input file '%s' does not match the given n.\n", filename);
+        printf("For n = %d the file size is expected to be (n * sizeof(double)) = %lu but the actual file size is %lu.\n",
+               particle_count, (unsigned long)expectedSize, (unsigned long)st.st_size);
+        close(fd);
+        return NULL;
+    }
+
+    Particles *particles = alloc_particles(particle_count);
+
+    if (particles == NULL || particle_count == 0)
+    {
+        close(fd);
+        return particles;
+    }
+
+    const double *buffer = mmap(NULL, expectedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (buffer == MAP_FAILED)
+    {
+        printf("Failed to read.\n");
+        free_particles(particles);
+        return NULL;
+    }
+    madvise((void *)buffer, expectedSize, MADV_SEQUENTIAL);
+
+    int thread_count = io_thread_count(expectedSize);
+
+    // Each thread faults in and copies its own contiguous slice of the file
+    pthread_t threads[MAX_LOAD_THREADS];
+    LoadInput input[MAX_LOAD_THREADS];
+    for (int t = 0; t < thread_count; t++)
+    {
+        input[t].buffer = buffer;
+        input[t].particles = particles;
+        input[t].start_n = (int)((long)particle_count * t / thread_count);
+        input[t].end_n = (int)((long)particle_count * (t + 1) / thread_count);
+        if (t > 0)
+        {
+            pthread_create(&threads[t], NULL, deinterleave, &input[t]);
+        }
+    }
+    deinterleave(&input[0]);
+    for (int t = 1; t < thread_count; t++)
+    {
+        pthread_join(threads[t], NULL);
+    }
+
+    munmap((void *)buffer, expectedSize);
+    return particles;
+}
+
+// pwrite may write less than asked for, keep going until everything is out
+static int write_all(int fd, const char *data, size_t bytes, off_t offset)
+{
+    while (bytes > 0)
+    {
+        ssize_t written = pwrite(fd, data, bytes, offset);
+        if (written <= 0)
+        {
+            return -1;
+        }
+        data += written;
+        bytes -= written;
+        offset += written;
+    }
+    return 0;
+}
+
+static void *interleave_and_write(void *arg)
+{
+    SaveInput *input = (SaveInput *)arg;
+    const Particles *particles = input->particles;
+    int chunk = input->end_n - input->start_n < WRITE_CHUNK_PARTICLES ? input->end_n - input->start_n : WRITE_CHUNK_PARTICLES;
+    double *buffer = malloc((size_t)FIELDS_PER_PARTICLE * (chunk > 0 ? chunk : 1) * sizeof(double));
+
+    input->status = 0;
+    for (int lo = input->start_n; lo < input->end_n && input->status == 0; lo += chunk)
+    {
+        int hi = lo + chunk < input->end_n ? lo + chunk : input->end_n;
+        for (int i = lo; i < hi; i++)
+        {
+            double *record = buffer + (size_t)FIELDS_PER_PARTICLE * (i - lo);
+            record[0] = particles->posx[i];
+            record[1] = particles->posy[i];
+            record[2] = particles->mass[i];
+            record[3] = particles->velx[i];
+            record[4] = particles->vely[i];
+            record[5] = particles->brightness[i];
+        }
+        size_t bytes = (size_t)FIELDS_PER_PARTICLE * (hi - lo) * sizeof(double);
+        off_t offset = (off_t)FIELDS_PER_PARTICLE * lo * sizeof(double);
+        input->status = write_all(input->fd, (const char *)buffer, bytes, offset);
+    }
+
+    free(buffer);
+    return NULL;
+}
+
+int save_file_v2(int particle_count, const Particles *particles, const char *filename)
+{
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        printf("Failed to open the output file.\n");
+        return -1;
+    }
+
+    int thread_count = io_thread_count((size_t)FIELDS_PER_PARTICLE * particle_count * sizeof(double));
+    pthread_t threads[MAX_LOAD_THREADS];
+    SaveInput input[MAX_LOAD_THREADS];
+    for (int t = 0; t < thread_count; t++)
+    {
+        input[t].particles = particles;
+        input[t].fd = fd;
+        input[t].start_n = (int)((long)particle_count * t / thread_count);
+        input[t].end_n = (int)((long)particle_count * (t + 1) / thread_count);
+        if (t > 0)
+        {
+            pthread_create(&threads[t], NULL, interleave_and_write, &input[t]);
+        }
+    }
+    interleave_and_write(&input[0]);
+
+    int status = input[0].status;
+    for (int t = 1; t < thread_count; t++)
+    {
+        pthread_join(threads[t], NULL);
+        status |= input[t].status;
+    }
+
+    if (close(fd) != 0 || status != 0)
+    {
+        printf("Failed to write the output file '%s'.\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+Particles *read_particles(int particle_count, const char *filename)
+{
+    if (galsnap_is_snapshot(filename))
+    {
+        return galsnap_load(filename, particle_count, NULL);
+    }
+    return read_data_v2(particle_count, filename);
+}
+
+int save_particles(int particle_count, const Particles *particles, const char *filename, long step, double delta_t)
+{
+    size_t length = strlen(filename);
+    if (length >= 6 && strcmp(filename + length - 6, ".gsnap") == 0)
+    {
+        return galsnap_save(filename, particle_count, particles, step, delta_t);
+    }
+    return save_file_v2(particle_count, particles, filename);
+}
+
+void free_particles(Particles *particles)
+{
+    if (particles->mapping != NULL)
+    {
+        // Only the accelerations live in the arena, everything else is part of the mapping
+        munmap(particles->mapping, particles->mapping_bytes);
+    }
+    arena_destroy(particles->arena);
+    free(particles);
+}
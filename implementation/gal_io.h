@@ -0,0 +1,89 @@
+#ifndef _gal_io_h
+#define _gal_io_h
+
+#include "particles.h"
+
+/*
+ * Function: read_data_v2
+ * Usage: Particles *particles = read_data_v2(N, filename);
+ * --------------------------------------------------------
+ * Loads a .gal file (6 doubles per particle: posx, posy, mass, velx, vely,
+ * brightness). The file is mapped with mmap and deinterleaved straight into
+ * 64-byte aligned arrays, so there is no intermediate buffer and no limit
+ * from the stack size. Large files are split over several threads. accx
+ * and accy are set to zero. Returns NULL if the file cannot be opened or
+ * its size does not match N.
+ */
+Particles *read_data_v2(int particle_count, const char *filename);
+
+/*
+ * Function: save_file_v2
+ * Usage: save_file_v2(N, particles, "result.gal");
+ * ------------------------------------------------
+ * Writes the particles in the .gal layout. Records are interleaved into a
+ * buffer and written in large pwrite calls instead of one fwrite per
+ * field, and large outputs are split over several threads that write
+ * disjoint parts of the file. The output is byte-identical to
+ * save_file_v1. Returns 0 on success and -1 on failure.
+ */
+int save_file_v2(int particle_count, const Particles *particles, const char *filename);
+
+/*
+ * Function: read_particles
+ * Usage: Particles *particles = read_particles(N, filename);
+ * ---------------------------------------------------------
+ * Maps the file with galsnap_load if it is a .gsnap snapshot and reads it
+ * with read_data_v2 otherwise.
+ */
+Particles *read_particles(int particle_count, const char *filename);
+
+/*
+ * Function: save_particles
+ * Usage: save_particles(N, particles, output_file, nsteps, delta_t);
+ * ------------------------------------------------------------------
+ * Writes a .gsnap snapshot if filename ends in ".gsnap" and a .gal file
+ * otherwise. step and delta_t are only stored in .gsnap headers.
+ */
+int save_particles(int particle_count, const Particles *particles, const char *filename, long step, double delta_t);
+
+/*
+ * Function: alloc_particles
+ * Usage: Particles *particles = alloc_particles(N);
+ * -------------------------------------------------
+ * Allocates the eight arrays for N particles from one arena, each 64-byte
+ * aligned and zero-filled. The arena also holds the scratch space set with
+ * set_particle_arena, which callers take with
+ * arena_alloc(particles->arena, bytes).
+ */
+Particles *alloc_particles(int particle_count);
+
+/*
+ * Function: set_particle_arena
+ * Usage: set_particle_arena(2 * threads * N * sizeof(double), huge_pages);
+ * ------------------------------------------------------------------------
+ * Sets how many bytes of scratch space every later particle arena reserves
+ * beyond the arrays themselves, and whether it asks for huge pages. Call it
+ * before loading the particles so that the whole run lives in one mapping.
+ */
+void set_particle_arena(size_t scratch_bytes, int huge_pages);
+
+/*
+ * Function: particle_arena_create
+ * Usage: Arena *arena = particle_arena_create(N, 2);
+ * --------------------------------------------------
+ * Creates an arena with room for array_count arrays of N doubles and the
+ * scratch space from set_particle_arena. Used by loaders that only
+ * allocate part of the arrays themselves.
+ */
+struct Arena *particle_arena_create(int particle_count, int array_count);
+
+/*
+ * Function: free_particles
+ * Usage: free_particles(particles);
+ * ---------------------------------
+ * Releases particles from read_data_v2, read_particles, galsnap_load or
+ * alloc_particles.
+ */
+void free_particles(Particles *particles);
+
+#endif
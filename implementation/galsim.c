@@ -3,34 +3,94 @@
 #include <string.h>
 #include <math.h>
 #include <sys/time.h>
+#include "particles.h"
+#include "gal_io.h"
+#include "options.h"
+#include "snapshot.h"
+#include "block_steps.h"
+#include "fmm.h"
+#include "pm.h"
+#include "reorder.h"
+#include "forces.h"
+#include "libgalsim.h"
 
-#define VERSION 2
-
-typedef struct
-{
-    double* posx;
-    double* posy;
-    double* mass;
-    double* velx;
-    double* vely;
-    double* accx;
-    double* accy;
-    double* brightness;
-} Particles;
-
-Particles *read_data_v1(int particle_count, char *filename);
-void save_file_v1(int particle_count, Particles *particles);
 void print_data(int N, Particles *particles);
 double get_wall_seconds();
+static void reorder_hook(Particles *particles, long step, void *data);
 
 int main(int argc, char *argv[])
 {
+    // Optional flags are taken out first so the positional arguments keep their indices
+    const char *output_file = "result.gal";
+    argc = extract_option(argc, argv, "--output", &output_file);
+    const char *snapshot_every = "0";
+    const char *snapshot_prefix = "snapshot";
+    argc = extract_option(argc, argv, "--snapshot-every", &snapshot_every);
+    argc = extract_option(argc, argv, "--snapshot-prefix", &snapshot_prefix);
+    const char *snapshot_format = "gal";
+    argc = extract_option(argc, argv, "--snapshot-format", &snapshot_format);
+    const char *snapshot_error = "0";
+    argc = extract_option(argc, argv, "--snapshot-error", &snapshot_error);
+    const char *integrator = "euler";
+    argc = extract_option(argc, argv, "--integrator", &integrator);
+    const char *block_levels = "0";
+    const char *block_eta = "0.025";
+    argc = extract_option(argc, argv, "--block-levels", &block_levels);
+    argc = extract_option(argc, argv, "--block-eta", &block_eta);
+    const char *fmm_order_option = "0";
+    const char *fmm_threads_option = "1";
+    argc = extract_option(argc, argv, "--fmm-order", &fmm_order_option);
+    argc = extract_option(argc, argv, "--fmm-threads", &fmm_threads_option);
+    int use_pm;
+    const char *pm_grid_option = "0";
+    argc = extract_flag(argc, argv, "--pm", &use_pm);
+    argc = extract_option(argc, argv, "--pm-grid", &pm_grid_option);
+    const char *reorder_every = "0";
+    const char *reorder_curve = "hilbert";
+    const char *reorder_threads = "1";
+    argc = extract_option(argc, argv, "--reorder-every", &reorder_every);
+    argc = extract_option(argc, argv, "--reorder-curve", &reorder_curve);
+    argc = extract_option(argc, argv, "--reorder-threads", &reorder_threads);
+    int huge_pages;
+    argc = extract_flag(argc, argv, "--huge-pages", &huge_pages);
+    const char *kernel_option = "simd";
+    argc = extract_option(argc, argv, "--kernel", &kernel_option);
 
     // Combine all validation (including type checks) into one method validateInput()
-    if (argc != 6)
+    if (argc != 6 && argc != 7)
     {
         printf("Incorrect number of arguments!\n");
-        printf("Usage: %s N filename nsteps delta_t graphics\n", argv[0]);
+        printf("Usage: %s N filename nsteps delta_t graphics [theta] [--output file]\n"
+               "       [--snapshot-every K] [--snapshot-prefix prefix] [--snapshot-format gal|gsnap|gsz]\n"
+               "       [--snapshot-error E] [--integrator euler|leapfrog] [--block-levels L] [--block-eta eta]\n"
+               "       [--fmm-order p] [--fmm-threads T] [--pm] [--pm-grid M]\n"
+               "       [--reorder-every K] [--reorder-curve morton|hilbert] [--reorder-threads T]\n"
+               "       [--huge-pages] [--kernel direct|symmetric|simd|tiled|mixed|auto]\n", argv[0]);
+        return 0;
+    }
+    const int leapfrog = strcmp(integrator, "leapfrog") == 0;
+    if (!leapfrog && strcmp(integrator, "euler") != 0)
+    {
+        printf("Unknown integrator %s, use euler or leapfrog.\n", integrator);
+        return 0;
+    }
+    if (strcmp(snapshot_format, "gal") != 0 && strcmp(snapshot_format, "gsnap") != 0 &&
+        strcmp(snapshot_format, "gsz") != 0)
+    {
+        printf("Unknown snapshot format %s, use gal, gsnap or gsz.\n", snapshot_format);
+        return 0;
+    }
+    // --kernel picks one of the exact direct sums, auto times them on the loaded particles
+    const int exact_kind = force_kernel_from_name(kernel_option);
+    if (strcmp(kernel_option, "auto") != 0 && (exact_kind < 0 || exact_kind > FORCE_MIXED))
+    {
+        printf("Unknown --kernel %s, use direct, symmetric, simd, tiled, mixed or auto.\n", kernel_option);
+        return 0;
+    }
+    const int levels = atoi(block_levels);
+    if (levels < 0 || levels > 20)
+    {
+        printf("--block-levels must be between 0 and 20.\n");
         return 0;
     }
 
@@ -40,106 +100,149 @@ int main(int argc, char *argv[])
     const int nsteps = atoi(argv[3]);
     const double delta_t = (double)atof(argv[4]);
     int graphics = atoi(argv[5]);
+    // Opening angle for Barnes-Hut, 0 keeps the exact O(N^2) kernels
+    double theta = argc == 7 ? atof(argv[6]) : 0.0;
+    // With --fmm-order the fast multipole method replaces both, and theta is its opening parameter
+    const int fmm_order = atoi(fmm_order_option);
+    const int fmm_threads = atoi(fmm_threads_option);
+    if (fmm_order < 0 || fmm_order > FMM_MAX_ORDER || fmm_threads < 1)
+    {
+        printf("--fmm-order must be between 1 and %d and --fmm-threads at least 1.\n", FMM_MAX_ORDER);
+        return 0;
+    }
+    if (fmm_order > 0 && theta <= 0.0)
+    {
+        theta = 0.5;
+    }
+    // The particle-mesh solver takes the grid size instead, 0 derives it from epsilon
+    const int pm_grid = atoi(pm_grid_option);
+    if (use_pm && fmm_order > 0)
+    {
+        printf("Choose either --pm or --fmm-order.\n");
+        return 0;
+    }
+    if (!use_pm && strcmp(pm_grid_option, "0") != 0)
+    {
+        printf("--pm-grid only applies together with --pm.\n");
+        return 0;
+    }
+    if (pm_grid < 0)
+    {
+        printf("--pm-grid must be at least 0.\n");
+        return 0;
+    }
+    if (levels > 0 && (theta > 0.0 || fmm_order > 0 || use_pm))
+    {
+        printf("Block time steps use the direct sum and cannot be combined with theta, the FMM or the PM solver.\n");
+        return 0;
+    }
+    if (levels > 0 && strcmp(kernel_option, "simd") != 0)
+    {
+        printf("Block time steps always use the simd kernel and cannot be combined with --kernel %s.\n", kernel_option);
+        return 0;
+    }
+    if ((theta > 0.0 || fmm_order > 0 || use_pm) && strcmp(kernel_option, "simd") != 0)
+    {
+        printf("theta, the FMM and the PM solver replace the direct sum and cannot be combined with --kernel %s.\n",
+               kernel_option);
+        return 0;
+    }
     const double epsilon = 0.001;
     const double G = 100.0 / N;
-    const double dtG = delta_t * (-G);
 
     if (graphics == 1)
     {
-        printf("Graphic implementation is not done. You will see the simulation results in result.gal file.\n");
+        printf("Graphic implementation is not done. You will see the simulation results in %s file.\n", output_file);
     }
 
     /* Read files. */
-    Particles *particles = read_data_v1(N, filename);
+    set_particle_arena(0, huge_pages);
+    Particles *particles = NULL;
+    Galsim *sim = NULL;
+    if (levels > 0)
+    {
+        particles = read_particles(N, filename);
+    }
+    else
+    {
+        // Everything but the block time steps runs on libgalsim; theta, --fmm-order and --pm replace the exact kernel
+        GalsimConfig config;
+        galsim_default_config(&config);
+        config.kernel = fmm_order > 0 ? "fmm" : use_pm ? "pm" : theta > 0.0 ? "barnes-hut" : kernel_option;
+        config.integrator = integrator;
+        config.delta_t = delta_t;
+        config.epsilon = epsilon;
+        config.theta = theta;
+        config.fmm_order = fmm_order > 0 ? fmm_order : config.fmm_order;
+        config.threads = fmm_threads;
+        config.pm_grid = pm_grid;
+        config.verbose = 1;
+        sim = galsim_create(&config);
+        if (sim != NULL && galsim_load(sim, N, filename) == 0)
+        {
+            particles = galsim_get_particles(sim);
+        }
+    }
 
     if (particles == NULL)
     {
         printf("The data didn't get loaded correctly! Please try again with correct parameters.\n");
+        galsim_destroy(sim);
         return 0;
     }
 
-    // Variables needed for calcluations
-    double aXi, aYi, rx, ry, r, rr, div_1_rr;
-    double rx_div, ry_div;
+    // Every K steps the state goes to <prefix>_<step>.gal / .gsnap or into <prefix>.gsz, written in the background
+    SnapshotWriter *snapshots = snapshot_writer_create(particles, N, atoi(snapshot_every), snapshot_prefix,
+                                                       snapshot_format, atof(snapshot_error), delta_t);
+    // Every K steps the arrays are sorted along a space-filling curve; snapshots and the output keep the file order
+    Reorder *reorder = reorder_create(N, atoi(reorder_every),
+                                      strcmp(reorder_curve, "morton") == 0 ? CURVE_MORTON : CURVE_HILBERT,
+                                      atoi(reorder_threads));
+    if (reorder != NULL)
+    {
+        snapshot_writer_set_order(snapshots, reorder->order);
+    }
+
     double startTime = get_wall_seconds();
 
-#if VERSION == 1
-    // Start simulation - Optimized version 1
-    for (int step = 0; step < nsteps; step++)
+    if (levels > 0)
     {
-        // Only the position of particles is needed to simulate the movement of other particles
-        // Therefore within the first loop accelerations are calculated and all the velocities for n+1 step is updated appropriately
-        // Positions cannot be updated witin the same loop
-        for (int i = 0; i < N; i++)
-        {
-            particles->accx[i] = 0.0;
-            particles->accy[i] = 0.0;
-            for (int j = 0; j < N; j++)
-            {
-                if (i != j)
-                {
-                    rx = particles->posx[i] - particles->posx[j];
-                    ry = particles->posy[i] - particles->posy[j];
-                    
-                    r = sqrt(rx * rx + ry * ry);
-                    rr = r + epsilon;
-                    div_1_rr = 1 / (rr * rr * rr);
-                    particles->accx[i] += particles->mass[j] * rx * div_1_rr;
-                    particles->accy[i] += particles->mass[j] * ry * div_1_rr;
-                }
-            }
-            particles->velx[i] += dtG * particles->accx[i];
-            particles->vely[i] += dtG * particles->accy[i];
-        }
-
-        for (int i = 0; i < N; i++)
+        // Start simulation - block time steps, each base step of delta_t ends with all particles synchronized
+        BlockSteps *steps = block_steps_create(particles, N, levels, atof(block_eta), epsilon, G);
+        for (int step = 0; step < nsteps; step++)
         {
-            particles->posx[i] += particles->velx[i] * delta_t;
-            particles->posy[i] += particles->vely[i] * delta_t;
+            reorder_step(reorder, particles, step);
+            block_steps_advance(steps, particles, delta_t);
+            snapshot_writer_step(snapshots, particles, step + 1);
         }
+        printf("Block time steps evaluated %.1f%% of the force rows of a global step of delta_t / %d.\n",
+               steps->rows_full > 0 ? 100.0 * steps->rows_computed / steps->rows_full : 0.0, 1 << levels);
+        block_steps_destroy(steps);
     }
-
-#else
-    // Start simulation - Optimized version 3
-    for (int step = 0; step < nsteps; step++)
+    else
     {
-        // Only the position of particles is needed to simulate the movement of other particles
-        // Therefore within the first loop accelerations are calculated and all the velocities for n+1 step is updated appropriately
-        // Positions cannot be updated witin the same loop
-        for (int i = 0; i < N; i++)
+        // Start simulation - one galsim_step call up to each snapshot, so the leapfrog only synchronizes the
+        // velocities when a snapshot or the output needs them
+        if (reorder != NULL)
         {
-            particles->accx[i] = 0.0;
-            particles->accy[i] = 0.0;
-            for (int j = i + 1; j < N; j++)
-            {
-                rx = particles->posx[i] - particles->posx[j];
-                ry = particles->posy[i] - particles->posy[j];
-                r = sqrt(rx * rx + ry * ry);
-                rr = r + epsilon;
-                div_1_rr = dtG / (rr * rr * rr);
-                rx_div = rx*div_1_rr;
-                ry_div = ry*div_1_rr;
-
-                // Calculating the acceleration of the i-th particle based on the forces applied by N-i particles
-                particles->accx[i] += particles->mass[j] * rx_div / delta_t;
-                particles->accy[i] += particles->mass[j] * ry_div / delta_t;
-
-                // Substracting the velocity change on the j-th particle due to the equal and opposite reaction
-                particles->velx[j] -=  particles->mass[i] * rx_div;
-                particles->vely[j] -=  particles->mass[i] * ry_div;
-            }
-            particles->velx[i] += particles->accx[i] * delta_t;
-            particles->vely[i] += particles->accy[i] * delta_t;
+            galsim_set_step_hook(sim, reorder_hook, reorder);
         }
-
-        for (int i = 0; i < N; i++)
+        for (int step = 0; step < nsteps;)
         {
-            particles->posx[i] += particles->velx[i] * delta_t;
-            particles->posy[i] += particles->vely[i] * delta_t;
+            int chunk = 1;
+            while (step + chunk < nsteps && !snapshot_writer_due(snapshots, step + chunk))
+            {
+                chunk++;
+            }
+            galsim_step(sim, chunk);
+            step += chunk;
+            snapshot_writer_step(snapshots, particles, step);
         }
     }
 
-#endif
+    snapshot_writer_destroy(snapshots);
+    reorder_restore(reorder, particles);
+    reorder_destroy(reorder);
 
     double totalTime = get_wall_seconds() - startTime;
     printf("Time taken for the simulation of %d particals for %d steps = %lf seconds.\n", N, nsteps, totalTime);
@@ -147,109 +250,31 @@ int main(int argc, char *argv[])
     // End simulation - Optimized version
 
     // SAVE DATA TO FILE
-    save_file_v1(N, particles);
-
-    free(particles->posx);
-    free(particles->posy);
-    free(particles->mass);
-    free(particles->velx);
-    free(particles->vely);
-    free(particles->accx);
-    free(particles->accy);
-    free(particles->brightness);
-    free(particles);
-    return 0;
-}
-
-double get_wall_seconds()
-{
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    double seconds = tv.tv_sec + (double)tv.tv_usec / 1000000;
-    return seconds;
-}
-
-Particles *read_data_v1(int particle_count, char *filename)
-{
-
-    /* Open input file and determine its size. */
-    FILE *input_file = fopen(filename, "rb");
-
-    if (!input_file)
-    {
-        printf("read_doubles_from_file error: failed to open input file '%s'.\n", filename);
-        return NULL;
-    }
-
-    /* Get filesize using fseek() and ftell(). */
-    fseek(input_file, 0L, SEEK_END);
-    size_t fileSize = ftell(input_file);
-
-    /* Now use fseek() again to set file position back to beginning of the file. */
-    fseek(input_file, 0L, SEEK_SET);
-
-    if (fileSize != 6 * particle_count * sizeof(double))
+    if (sim != NULL)
     {
-        printf("read_doubles_from_file error: size of input file '%s' does not match the given n.\n", filename);
-        printf("For n = %d the file size is expected to be (n * sizeof(double)) = %lu but the actual file size is %lu.\n",
-               particle_count, 6 * particle_count * sizeof(double), fileSize);
-        return NULL;
+        galsim_save(sim, output_file);
+        galsim_destroy(sim);
     }
-
-    double buffer[6 * particle_count];
-    if (!fread(buffer, sizeof(char), fileSize, input_file))
-    {
-        printf("Failed to read.\n");
-    }
-
-    Particles *particles = malloc(sizeof(Particles));
-
-    // Particle *particles = malloc(particle_count * sizeof(Particle));
-
-    // Allocate memory for each array member
-    particles->posx = malloc(particle_count * sizeof(double));
-    particles->posy = malloc(particle_count * sizeof(double));
-    particles->mass = malloc(particle_count * sizeof(double));
-    particles->velx = malloc(particle_count * sizeof(double));
-    particles->vely = malloc(particle_count * sizeof(double));
-    particles->accx = malloc(particle_count * sizeof(double));
-    particles->accy = malloc(particle_count * sizeof(double));
-    particles->brightness = malloc(particle_count * sizeof(double));
-
-    for (int i = 0; i < particle_count; i++)
+    else
     {
-        particles->posx[i] = buffer[(6 * i) + 0];
-        particles->posy[i] = buffer[(6 * i) + 1];
-        particles->mass[i] = buffer[(6 * i) + 2];
-        particles->velx[i] = buffer[(6 * i) + 3];
-        particles->vely[i] = buffer[(6 * i) + 4];
-        particles->brightness[i] = buffer[(6 * i) + 5];
-        // we don't initiate accx and accy at this point - the values will be null
+        save_particles(N, particles, output_file, nsteps, delta_t);
+        free_particles(particles);
     }
-
-    fclose(input_file);
-    return particles;
+    return 0;
 }
 
-void save_file_v1(int particle_count, Particles *particles)
+// Step hook of libgalsim, sorts the particles along the curve every K steps
+static void reorder_hook(Particles *particles, long step, void *data)
 {
-
-    FILE *output_file = fopen("result.gal", "wb");
-    if (!output_file) {
-        printf("Failed to open the output file.\n");
-        return;
+    reorder_step((Reorder *)data, particles, (int)step);
 }
 
-    for (int i = 0; i < particle_count; i++)
-    {
-        fwrite(&(particles->posx[i]), sizeof(double), 1, output_file);
-        fwrite(&(particles->posy[i]), sizeof(double), 1, output_file);
-        fwrite(&(particles->mass[i]), sizeof(double), 1, output_file);
-        fwrite(&(particles->velx[i]), sizeof(double), 1, output_file);
-        fwrite(&(particles->vely[i]), sizeof(double), 1, output_file);
-        fwrite(&(particles->brightness[i]), sizeof(double), 1, output_file);
-    }
-    fclose(output_file);
+double get_wall_seconds()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    double seconds = tv.tv_sec + (double)tv.tv_usec / 1000000;
+    return seconds;
 }
 
 void print_data(int N, Particles *particles)
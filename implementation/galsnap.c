@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "galsnap.h"
+#include "gal_io.h"
+#include "arena.h"
+
+#define FIELD_COUNT 6
+
+static const char *field_names[FIELD_COUNT] = {"posx", "posy", "mass", "velx", "vely", "brightness"};
+
+static uint64_t align_up(uint64_t offset)
+{
+    return (offset + GALSNAP_ALIGNMENT - 1) / GALSNAP_ALIGNMENT * GALSNAP_ALIGNMENT;
+}
+
+// Collects the Particles arrays in the order of field_names
+static void particle_fields(const Particles *particles, double *fields[FIELD_COUNT])
+{
+    fields[0] = particles->posx;
+    fields[1] = particles->posy;
+    fields[2] = particles->mass;
+    fields[3] = particles->velx;
+    fields[4] = particles->vely;
+    fields[5] = particles->brightness;
+}
+
+static int write_all(int fd, const void *data, size_t bytes, off_t offset)
+{
+    const char *p = data;
+    while (bytes > 0)
+    {
+        ssize_t written = pwrite(fd, p, bytes, offset);
+        if (written <= 0)
+        {
+            return -1;
+        }
+        p += written;
+        bytes -= written;
+        offset += written;
+    }
+    return 0;
+}
+
+int galsnap_is_snapshot(const char *filename)
+{
+    char magic[8] = {0};
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        return 0;
+    }
+    ssize_t got = read(fd, magic, sizeof(magic));
+    close(fd);
+    return got == sizeof(magic) && strncmp(magic, GALSNAP_MAGIC, sizeof(magic)) == 0;
+}
+
+int galsnap_save(const char *filename, int particle_count, const Particles *particles, long step, double delta_t)
+{
+    GalsnapHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GALSNAP_MAGIC, strlen(GALSNAP_MAGIC));
+    header.version = GALSNAP_VERSION;
+    header.endian = GALSNAP_ENDIAN_MARK;
+    header.N = particle_count;
+    header.step = step;
+    header.time = step * delta_t;
+    header.delta_t = delta_t;
+    header.field_count = FIELD_COUNT;
+
+    uint64_t bytes = (uint64_t)particle_count * sizeof(double);
+    uint64_t offset = align_up(sizeof(GalsnapHeader));
+    for (int f = 0; f < FIELD_COUNT; f++)
+    {
+        strncpy(header.fields[f].name, field_names[f], sizeof(header.fields[f].name) - 1);
+        header.fields[f].type = GALSNAP_FLOAT64;
+        header.fields[f].offset = offset;
+        header.fields[f].bytes = bytes;
+        offset = align_up(offset + bytes);
+    }
+
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        printf("Failed to open the output file.\n");
+        return -1;
+    }
+
+    double *fields[FIELD_COUNT];
+    particle_fields(particles, fields);
+    int status = write_all(fd, &header, sizeof(header), 0);
+    for (int f = 0; f < FIELD_COUNT && status == 0; f++)
+    {
+        status = write_all(fd, fields[f], bytes, header.fields[f].offset);
+    }
+    // Extend the file over the padding after the last chunk so every chunk can be mapped whole
+    if (status == 0)
+    {
+        status = ftruncate(fd, offset);
+    }
+
+    if (close(fd) != 0 || status != 0)
+    {
+        printf("Failed to write the output file '%s'.\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+Particles *galsnap_load(const char *filename, int particle_count, GalsnapHeader *header)
+{
+    GalsnapHeader local;
+    if (header == NULL)
+    {
+        header = &local;
+    }
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        printf("read_doubles_from_file error: failed to open input file '%s'.\n", filename);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(GalsnapHeader) ||
+        pread(fd, header, sizeof(GalsnapHeader), 0) != sizeof(GalsnapHeader) ||
+        strncmp(header->magic, GALSNAP_MAGIC, sizeof(header->magic)) != 0)
+    {
+        printf("'%s' is not a .gsnap file.\n", filename);
+        close(fd);
+        return NULL;
+    }
+    if (header->endian != GALSNAP_ENDIAN_MARK)
+    {
+        printf("'%s' was written on a machine with the other byte order.\n", filename);
+        close(fd);
+        return NULL;
+    }
+    if (header->version != GALSNAP_VERSION || header->field_count > GALSNAP_MAX_FIELDS)
+    {
+        printf("'%s' has unsupported version %u.\n", filename, header->version);
+        close(fd);
+        return NULL;
+    }
+    if (particle_count >= 0 && header->N != (uint64_t)particle_count)
+    {
+        printf("read_doubles_from_file error: '%s' holds %lu particles but n = %d.\n",
+               filename, (unsigned long)header->N, particle_count);
+        close(fd);
+        return NULL;
+    }
+
+    // Locate the required fields and check that they lie inside the file, without letting a corrupt size wrap around
+    const uint64_t file_bytes = (uint64_t)st.st_size;
+    if (header->N > file_bytes / sizeof(double) || header->N > INT_MAX)
+    {
+        printf("'%s' has an invalid particle count.\n", filename);
+        close(fd);
+        return NULL;
+    }
+    uint64_t bytes = header->N * sizeof(double);
+    uint64_t offsets[FIELD_COUNT];
+    for (int f = 0; f < FIELD_COUNT; f++)
+    {
+        int found = 0;
+        for (uint32_t k = 0; k < header->field_count && !found; k++)
+        {
+            const GalsnapField *field = &header->fields[k];
+            if (strncmp(field->name, field_names[f], sizeof(field->name)) == 0 && field->type == GALSNAP_FLOAT64 &&
+                field->bytes == bytes && field->offset % sizeof(double) == 0 &&
+                field->offset <= file_bytes && bytes <= file_bytes - field->offset)
+            {
+                offsets[f] = field->offset;
+                found = 1;
+            }
+        }
+        if (!found)
+        {
+            printf("'%s' has no valid '%s' field.\n", filename, field_names[f]);
+            close(fd);
+            return NULL;
+        }
+    }
+
+    // Private writable mapping: the simulation updates the arrays in place without touching the file
+    char *base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        printf("Failed to read.\n");
+        return NULL;
+    }
+
+    Particles *particles = malloc(sizeof(Particles));
+    particles->posx = (double *)(base + offsets[0]);
+    particles->posy = (double *)(base + offsets[1]);
+    particles->mass = (double *)(base + offsets[2]);
+    particles->velx = (double *)(base + offsets[3]);
+    particles->vely = (double *)(base + offsets[4]);
+    particles->brightness = (double *)(base + offsets[5]);
+    particles->mapping = base;
+    particles->mapping_bytes = st.st_size;
+
+    // The accelerations and any scratch space come from the arena, zero-filled, sized from the file's count
+    Arena *arena = particle_arena_create((int)header->N, 2);
+    particles->accx = arena != NULL ? arena_alloc(arena, bytes) : NULL;
+    particles->accy = arena != NULL ? arena_alloc(arena, bytes) : NULL;
+    if (particles->accx == NULL || particles->accy == NULL)
+    {
+        printf("Failed to allocate the acceleration arrays.\n");
+        arena_destroy(arena);
+        munmap(base, st.st_size);
+        free(particles);
+        return NULL;
+    }
+    particles->arena = arena;
+    return particles;
+}
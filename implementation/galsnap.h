@@ -0,0 +1,75 @@
+#ifndef _galsnap_h
+#define _galsnap_h
+
+#include <stdint.h>
+#include "particles.h"
+
+/*
+ * Self-describing snapshot format (.gsnap). A fixed header is followed by
+ * one contiguous chunk per field. Every chunk starts on a 4096-byte
+ * boundary, so a mapped file can be used as the Particles arrays directly,
+ * without the deinterleave a .gal file needs.
+ */
+#define GALSNAP_MAGIC "GALSNAP"
+#define GALSNAP_VERSION 1
+// Written in native byte order; a reader on the other endianness sees 0x04030201
+#define GALSNAP_ENDIAN_MARK 0x01020304u
+#define GALSNAP_MAX_FIELDS 16
+#define GALSNAP_ALIGNMENT 4096
+#define GALSNAP_FLOAT64 1
+
+typedef struct
+{
+    char name[16];
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t bytes;
+} GalsnapField;
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    uint64_t N;
+    uint64_t step;
+    double time;
+    double delta_t;
+    uint32_t field_count;
+    uint32_t reserved;
+    GalsnapField fields[GALSNAP_MAX_FIELDS];
+} GalsnapHeader;
+
+/*
+ * Function: galsnap_is_snapshot
+ * Usage: if (galsnap_is_snapshot(filename)) ...
+ * ---------------------------------------------
+ * Returns 1 if the file starts with the .gsnap magic, 0 otherwise.
+ */
+int galsnap_is_snapshot(const char *filename);
+
+/*
+ * Function: galsnap_save
+ * Usage: galsnap_save("state.gsnap", N, particles, step, delta_t);
+ * ----------------------------------------------------------------
+ * Writes posx, posy, mass, velx, vely and brightness, each as one chunk
+ * written straight from the array. time is stored as step * delta_t.
+ * Returns 0 on success and -1 on failure.
+ */
+int galsnap_save(const char *filename, int particle_count, const Particles *particles, long step, double delta_t);
+
+/*
+ * Function: galsnap_load
+ * Usage: Particles *particles = galsnap_load("state.gsnap", N, &header);
+ * ---------------------------------------------------------------------
+ * Maps the file copy-on-write and points the Particles arrays into the
+ * mapping, so nothing is read until a page is first touched. Only
+ * accx/accy are allocated. Pass N = -1 to accept any particle count.
+ * header may be NULL. Release the result with free_particles. Returns
+ * NULL if the file is missing, malformed, has the other byte order, lacks
+ * a field, or has a different N.
+ */
+Particles *galsnap_load(const char *filename, int particle_count, GalsnapHeader *header);
+
+#endif
@@ -0,0 +1,287 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "gsz.h"
+#include "lz.h"
+
+// Grid indices of quantized positions stay below 2^62, so they and their differences fit in 64 bits
+#define QUANTIZE_LIMIT 4611686018427387904.0
+
+// Returns 1 if every value of the field maps to a grid index below QUANTIZE_LIMIT, 0 for overflow or NaN
+static int quantizable(const double *field, int n, double scale)
+{
+    for (int i = 0; i < n; i++)
+    {
+        if (!(fabs(field[i]) * scale < QUANTIZE_LIMIT))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void particle_fields(const Particles *particles, double *fields[GSZ_FIELDS])
+{
+    fields[0] = particles->posx;
+    fields[1] = particles->posy;
+    fields[2] = particles->mass;
+    fields[3] = particles->velx;
+    fields[4] = particles->vely;
+    fields[5] = particles->brightness;
+}
+
+// Byte b of word i goes to plane b, so the mostly zero high bytes of the deltas end up next to each other
+static void shuffle(const uint64_t *words, int n, uint8_t *planes)
+{
+    for (int i = 0; i < n; i++)
+    {
+        uint64_t w = words[i];
+        for (int b = 0; b < 8; b++)
+        {
+            planes[(size_t)b * n + i] = (uint8_t)(w >> (8 * b));
+        }
+    }
+}
+
+static void unshuffle(const uint8_t *planes, int n, uint64_t *words)
+{
+    for (int i = 0; i < n; i++)
+    {
+        uint64_t w = 0;
+        for (int b = 0; b < 8; b++)
+        {
+            w |= (uint64_t)planes[(size_t)b * n + i] << (8 * b);
+        }
+        words[i] = w;
+    }
+}
+
+static GszStream *stream_create(FILE *file, int N, double position_error)
+{
+    GszStream *stream = malloc(sizeof(GszStream));
+    stream->file = file;
+    stream->N = N;
+    stream->position_error = position_error;
+    for (int f = 0; f < GSZ_FIELDS; f++)
+    {
+        // The first frame is encoded against zeros
+        stream->previous[f] = calloc(N, sizeof(uint64_t));
+    }
+    stream->words = malloc(N * sizeof(uint64_t));
+    stream->shuffled = malloc(N * sizeof(uint64_t));
+    stream->packed = malloc(lz_bound(N * sizeof(uint64_t)));
+    return stream;
+}
+
+int gsz_is_stream(const char *filename)
+{
+    char magic[8] = {0};
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL)
+    {
+        return 0;
+    }
+    size_t got = fread(magic, 1, sizeof(magic), file);
+    fclose(file);
+    return got == sizeof(magic) && strncmp(magic, GSZ_MAGIC, sizeof(magic)) == 0;
+}
+
+GszStream *gsz_writer_create(const char *filename, int N, double position_error)
+{
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL)
+    {
+        printf("Could not create %s.\n", filename);
+        return NULL;
+    }
+
+    GszHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GSZ_MAGIC, strlen(GSZ_MAGIC));
+    header.version = GSZ_VERSION;
+    header.endian = GSZ_ENDIAN_MARK;
+    header.N = N;
+    header.position_error = position_error > 0.0 ? position_error : 0.0;
+    if (fwrite(&header, sizeof(header), 1, file) != 1)
+    {
+        fclose(file);
+        return NULL;
+    }
+    return stream_create(file, N, header.position_error);
+}
+
+int gsz_writer_append(GszStream *stream, const Particles *particles, long step, double delta_t)
+{
+    const int N = stream->N;
+    const size_t plane_bytes = N * sizeof(uint64_t);
+    double *fields[GSZ_FIELDS];
+    particle_fields(particles, fields);
+
+    GszFrameHeader frame;
+    memset(&frame, 0, sizeof(frame));
+    frame.step = step;
+    frame.time = step * delta_t;
+    frame.delta_t = delta_t;
+
+    // The header goes first with the sizes left blank, and is rewritten once they are known
+    long frame_start = ftell(stream->file);
+    if (fwrite(&frame, sizeof(frame), 1, stream->file) != 1)
+    {
+        return -1;
+    }
+
+    for (int f = 0; f < GSZ_FIELDS; f++)
+    {
+        uint64_t *previous = stream->previous[f];
+        const double scale = stream->position_error > 0.0 ? 1.0 / (2.0 * stream->position_error) : 0.0;
+        if (f < 2 && stream->position_error > 0.0 && quantizable(fields[f], N, scale))
+        {
+            // Grid indices change little between snapshots, so their differences are small integers.
+            // Positions that do not fit the grid take the lossless path below, the reader follows each frame's encoding
+            for (int i = 0; i < N; i++)
+            {
+                uint64_t q = (uint64_t)llround(fields[f][i] * scale);
+                int64_t delta = (int64_t)(q - previous[i]);
+                // Zigzag, so small negative differences also have zero high bytes
+                stream->words[i] = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+                previous[i] = q;
+            }
+            frame.encoding[f] = GSZ_QUANTIZED;
+        }
+        else
+        {
+            // Sign, exponent and leading mantissa bits usually survive a step, so the XOR starts with zero bytes
+            for (int i = 0; i < N; i++)
+            {
+                uint64_t bits;
+                memcpy(&bits, &fields[f][i], sizeof(bits));
+                stream->words[i] = bits ^ previous[i];
+                previous[i] = bits;
+            }
+            frame.encoding[f] = GSZ_XOR;
+        }
+
+        shuffle(stream->words, N, stream->shuffled);
+        frame.bytes[f] = lz_compress(stream->shuffled, plane_bytes, stream->packed);
+        if (fwrite(stream->packed, 1, frame.bytes[f], stream->file) != frame.bytes[f])
+        {
+            return -1;
+        }
+    }
+
+    long frame_end = ftell(stream->file);
+    if (fseek(stream->file, frame_start, SEEK_SET) != 0 || fwrite(&frame, sizeof(frame), 1, stream->file) != 1 ||
+        fseek(stream->file, frame_end, SEEK_SET) != 0)
+    {
+        return -1;
+    }
+    return fflush(stream->file) == 0 ? 0 : -1;
+}
+
+GszStream *gsz_reader_open(const char *filename, GszHeader *header)
+{
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL)
+    {
+        printf("Could not open %s.\n", filename);
+        return NULL;
+    }
+
+    GszHeader h;
+    if (fread(&h, sizeof(h), 1, file) != 1 || strncmp(h.magic, GSZ_MAGIC, sizeof(h.magic)) != 0 ||
+        h.version != GSZ_VERSION)
+    {
+        printf("%s is not a .gsz stream.\n", filename);
+        fclose(file);
+        return NULL;
+    }
+    if (h.endian != GSZ_ENDIAN_MARK)
+    {
+        printf("%s was written with the other byte order.\n", filename);
+        fclose(file);
+        return NULL;
+    }
+
+    if (header != NULL)
+    {
+        *header = h;
+    }
+    return stream_create(file, (int)h.N, h.position_error);
+}
+
+int gsz_reader_next(GszStream *stream, Particles *particles, long *step)
+{
+    const int N = stream->N;
+    const size_t plane_bytes = N * sizeof(uint64_t);
+    double *fields[GSZ_FIELDS];
+    particle_fields(particles, fields);
+
+    GszFrameHeader frame;
+    size_t got = fread(&frame, 1, sizeof(frame), stream->file);
+    if (got == 0 && feof(stream->file))
+    {
+        return 0;
+    }
+    if (got != sizeof(frame))
+    {
+        return -1;
+    }
+
+    for (int f = 0; f < GSZ_FIELDS; f++)
+    {
+        uint64_t *previous = stream->previous[f];
+        if (frame.bytes[f] > lz_bound(plane_bytes) ||
+            fread(stream->packed, 1, frame.bytes[f], stream->file) != frame.bytes[f] ||
+            lz_decompress(stream->packed, frame.bytes[f], stream->shuffled, plane_bytes) != 0)
+        {
+            return -1;
+        }
+        unshuffle(stream->shuffled, N, stream->words);
+
+        if (frame.encoding[f] == GSZ_QUANTIZED)
+        {
+            const double spacing = 2.0 * stream->position_error;
+            for (int i = 0; i < N; i++)
+            {
+                uint64_t zigzag = stream->words[i];
+                previous[i] += (zigzag >> 1) ^ (0 - (zigzag & 1));
+                fields[f][i] = (double)(int64_t)previous[i] * spacing;
+            }
+        }
+        else if (frame.encoding[f] == GSZ_XOR)
+        {
+            for (int i = 0; i < N; i++)
+            {
+                previous[i] ^= stream->words[i];
+                memcpy(&fields[f][i], &previous[i], sizeof(double));
+            }
+        }
+        else
+        {
+            return -1;
+        }
+    }
+
+    if (step != NULL)
+    {
+        *step = (long)frame.step;
+    }
+    return 1;
+}
+
+void gsz_close(GszStream *stream)
+{
+    if (stream == NULL)
+    {
+        return;
+    }
+    fclose(stream->file);
+    for (int f = 0; f < GSZ_FIELDS; f++)
+    {
+        free(stream->previous[f]);
+    }
+    free(stream->words);
+    free(stream->shuffled);
+    free(stream->packed);
+    free(stream);
+}
@@ -0,0 +1,111 @@
+#ifndef _gsz_h
+#define _gsz_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include "particles.h"
+
+/*
+ * Compressed snapshot stream (.gsz). One file holds a header followed by
+ * any number of frames, each the full state at one step. Every field is
+ * delta encoded against the previous frame, byte shuffled into eight
+ * planes and packed with the codec in lz.h. With a positive position
+ * error, posx/posy are first rounded to a grid of spacing 2 * error, so
+ * no coordinate moves by more than error. Everything else is lossless.
+ */
+#define GSZ_MAGIC "GALSZ"
+#define GSZ_VERSION 1
+#define GSZ_ENDIAN_MARK 0x01020304u
+#define GSZ_FIELDS 6
+// Field encodings: XOR with the previous frame's bits, or difference of grid indices
+#define GSZ_XOR 1
+#define GSZ_QUANTIZED 2
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    uint64_t N;
+    double position_error;
+} GszHeader;
+
+typedef struct
+{
+    uint64_t step;
+    double time;
+    double delta_t;
+    uint32_t encoding[GSZ_FIELDS];
+    uint64_t bytes[GSZ_FIELDS];
+} GszFrameHeader;
+
+typedef struct
+{
+    FILE *file;
+    int N;
+    double position_error;
+    // Previous frame per field: raw bits, or grid indices for quantized fields
+    uint64_t *previous[GSZ_FIELDS];
+    uint64_t *words;
+    uint8_t *shuffled;
+    uint8_t *packed;
+} GszStream;
+
+/*
+ * Function: gsz_is_stream
+ * Usage: if (gsz_is_stream(filename)) ...
+ * ---------------------------------------
+ * Returns 1 if the file starts with the .gsz magic, 0 otherwise.
+ */
+int gsz_is_stream(const char *filename);
+
+/*
+ * Function: gsz_writer_create
+ * Usage: GszStream *stream = gsz_writer_create("run.gsz", N, 0.0);
+ * ----------------------------------------------------------------
+ * Creates the file and writes its header. position_error = 0 keeps every
+ * field lossless. Returns NULL if the file cannot be created.
+ */
+GszStream *gsz_writer_create(const char *filename, int N, double position_error);
+
+/*
+ * Function: gsz_writer_append
+ * Usage: gsz_writer_append(stream, particles, step, delta_t);
+ * -----------------------------------------------------------
+ * Compresses posx, posy, mass, velx, vely and brightness as one frame and
+ * appends it. A position field that would not fit the quantization grid,
+ * because position_error is tiny next to the coordinates, is stored
+ * losslessly in that frame instead. The file is flushed, so every finished frame can be read
+ * even if the run stops. Returns 0 on success and -1 on failure.
+ */
+int gsz_writer_append(GszStream *stream, const Particles *particles, long step, double delta_t);
+
+/*
+ * Function: gsz_reader_open
+ * Usage: GszStream *stream = gsz_reader_open("run.gsz", &header);
+ * ---------------------------------------------------------------
+ * Opens a stream for reading frames in order. header may be NULL.
+ * Returns NULL if the file is missing, malformed or has the other byte
+ * order.
+ */
+GszStream *gsz_reader_open(const char *filename, GszHeader *header);
+
+/*
+ * Function: gsz_reader_next
+ * Usage: while (gsz_reader_next(stream, particles, &step) == 1) ...
+ * -----------------------------------------------------------------
+ * Decodes the next frame into the six data arrays of particles, which
+ * must hold N values each. Returns 1 for a frame, 0 at the end of the
+ * stream and -1 if the frame is truncated or corrupt.
+ */
+int gsz_reader_next(GszStream *stream, Particles *particles, long *step);
+
+/*
+ * Function: gsz_close
+ * Usage: gsz_close(stream);
+ * -------------------------
+ * Closes a stream opened for writing or reading.
+ */
+void gsz_close(GszStream *stream);
+
+#endif
@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libgalsim.h"
+#include "gal_io.h"
+#include "forces.h"
+
+struct Galsim
+{
+    GalsimConfig config;
+    ForceKernel kind;
+    // kind is picked by force_kernel_calibrate on every load
+    int auto_kernel;
+    int leapfrog;
+    int N;
+    long step;
+    double G;
+    // NULL until galsim_load succeeds, forces is only set up while it is not
+    Particles *particles;
+    ForceMethod forces;
+    GalsimStepHook hook;
+    void *hook_data;
+};
+
+void galsim_default_config(GalsimConfig *config)
+{
+    config->kernel = "simd";
+    config->integrator = "euler";
+    config->delta_t = 1e-5;
+    config->epsilon = 0.001;
+    config->theta = 0.5;
+    config->fmm_order = 6;
+    config->threads = 1;
+    config->pm_grid = 0;
+    config->verbose = 0;
+}
+
+Galsim *galsim_create(const GalsimConfig *config)
+{
+    GalsimConfig defaults;
+    galsim_default_config(&defaults);
+    if (config == NULL)
+    {
+        config = &defaults;
+    }
+
+    int auto_kernel = strcmp(config->kernel, "auto") == 0;
+    int kind = auto_kernel ? FORCE_SIMD : force_kernel_from_name(config->kernel);
+    int leapfrog = strcmp(config->integrator, "leapfrog") == 0;
+    if (kind < 0 || (!leapfrog && strcmp(config->integrator, "euler") != 0) || config->epsilon < 0.0 ||
+        config->threads < 1 || config->pm_grid < 0 ||
+        (kind == FORCE_FMM && (config->fmm_order < 1 || config->fmm_order > FMM_MAX_ORDER)))
+    {
+        return NULL;
+    }
+
+    Galsim *sim = malloc(sizeof(Galsim));
+    sim->config = *config;
+    sim->kind = (ForceKernel)kind;
+    sim->auto_kernel = auto_kernel;
+    sim->leapfrog = leapfrog;
+    sim->N = 0;
+    sim->step = 0;
+    sim->G = 0.0;
+    sim->particles = NULL;
+    sim->hook = NULL;
+    sim->hook_data = NULL;
+    return sim;
+}
+
+// The calibration table and the kernel line that the galsim command prints
+static void print_calibration(const double *seconds, ForceKernel kind)
+{
+    printf("Calibration (ms per force evaluation):");
+    for (int k = 0; k < FORCE_KERNEL_COUNT; k++)
+    {
+        if (seconds[k] >= 0.0)
+        {
+            printf(" %s %.3f", force_kernel_name((ForceKernel)k), 1000.0 * seconds[k]);
+        }
+    }
+    printf(", picked %s.\n", force_kernel_name(kind));
+}
+
+static void print_method(const Galsim *sim)
+{
+    const ForceMethod *forces = &sim->forces;
+    if (forces->kind == FORCE_FMM)
+    {
+        printf("Using the FMM of order %d with theta = %g on %d threads", sim->config.fmm_order, sim->config.theta,
+               sim->config.threads);
+    }
+    else if (forces->kind == FORCE_PM)
+    {
+        printf("Using the particle-mesh solver on a %dx%d grid", forces->pm->grid, forces->pm->grid);
+    }
+    else if (strcmp(forces->name, force_kernel_name(forces->kind)) != 0)
+    {
+        printf("Using the %s force kernel (%s)", force_kernel_name(forces->kind), forces->name);
+    }
+    else
+    {
+        printf("Using the %s force kernel", forces->name);
+    }
+    printf(sim->leapfrog ? " with the leapfrog integrator.\n" : ".\n");
+}
+
+// Drops the particles and the kernel state that belongs to them
+static void galsim_unload(Galsim *sim)
+{
+    if (sim->particles != NULL)
+    {
+        force_method_release(&sim->forces);
+        free_particles(sim->particles);
+        sim->particles = NULL;
+    }
+    sim->N = 0;
+    sim->step = 0;
+}
+
+int galsim_load(Galsim *sim, int N, const char *filename)
+{
+    galsim_unload(sim);
+    Particles *particles = read_particles(N, filename);
+    if (particles == NULL)
+    {
+        return -1;
+    }
+    const GalsimConfig *config = &sim->config;
+    if (sim->auto_kernel)
+    {
+        double seconds[FORCE_KERNEL_COUNT];
+        sim->kind = force_kernel_calibrate(particles, N, config->epsilon, seconds);
+        if (config->verbose)
+        {
+            print_calibration(seconds, sim->kind);
+        }
+    }
+    if (force_method_init(&sim->forces, sim->kind, particles, N, config->epsilon, config->theta, config->fmm_order,
+                          config->threads, config->pm_grid) != 0)
+    {
+        free_particles(particles);
+        return -1;
+    }
+    if (config->verbose)
+    {
+        print_method(sim);
+    }
+
+    sim->particles = particles;
+    sim->N = N;
+    sim->G = N > 0 ? 100.0 / N : 0.0;
+    // The leapfrog opens every step with a half kick from the forces at the current positions
+    if (sim->leapfrog)
+    {
+        compute_forces(&sim->forces, particles);
+    }
+    return 0;
+}
+
+int galsim_step(Galsim *sim, int nsteps)
+{
+    if (sim->particles == NULL)
+    {
+        return -1;
+    }
+    Particles *particles = sim->particles;
+    const int N = sim->N;
+    const double delta_t = sim->config.delta_t;
+    const double dtG = delta_t * (-sim->G);
+
+    for (int step = 0; step < nsteps; step++)
+    {
+        if (sim->hook != NULL)
+        {
+            sim->hook(particles, sim->step, sim->hook_data);
+        }
+        if (sim->leapfrog)
+        {
+            // Kick-drift-kick, accx/accy always hold the forces at the current positions. The closing half kick
+            // of one step and the opening half kick of the next are merged into one full kick, which shares a
+            // sweep with the drift.
+            const double kick = step == 0 ? 0.5 * dtG : dtG;
+            for (int i = 0; i < N; i++)
+            {
+                particles->velx[i] += kick * particles->accx[i];
+                particles->vely[i] += kick * particles->accy[i];
+                particles->posx[i] += particles->velx[i] * delta_t;
+                particles->posy[i] += particles->vely[i] * delta_t;
+            }
+            compute_forces(&sim->forces, particles);
+        }
+        else
+        {
+            compute_forces(&sim->forces, particles);
+            for (int i = 0; i < N; i++)
+            {
+                particles->velx[i] += dtG * particles->accx[i];
+                particles->vely[i] += dtG * particles->accy[i];
+                particles->posx[i] += particles->velx[i] * delta_t;
+                particles->posy[i] += particles->vely[i] * delta_t;
+            }
+        }
+        sim->step++;
+    }
+
+    // The last closing half kick brings the velocities to the time of the positions
+    if (sim->leapfrog && nsteps > 0)
+    {
+        for (int i = 0; i < N; i++)
+        {
+            particles->velx[i] += 0.5 * dtG * particles->accx[i];
+            particles->vely[i] += 0.5 * dtG * particles->accy[i];
+        }
+    }
+    return 0;
+}
+
+void galsim_set_step_hook(Galsim *sim, GalsimStepHook hook, void *data)
+{
+    sim->hook = hook;
+    sim->hook_data = data;
+}
+
+const Particles *galsim_get_state(const Galsim *sim)
+{
+    return sim->particles;
+}
+
+Particles *galsim_get_particles(Galsim *sim)
+{
+    return sim->particles;
+}
+
+int galsim_save(const Galsim *sim, const char *filename)
+{
+    if (sim->particles == NULL)
+    {
+        return -1;
+    }
+    return save_particles(sim->N, sim->particles, filename, sim->step, sim->config.delta_t);
+}
+
+const char *galsim_kernel_name(const Galsim *sim)
+{
+    return sim->particles != NULL ? sim->forces.name : force_kernel_name(sim->kind);
+}
+
+int galsim_particle_count(const Galsim *sim)
+{
+    return sim->N;
+}
+
+long galsim_step_count(const Galsim *sim)
+{
+    return sim->step;
+}
+
+void galsim_destroy(Galsim *sim)
+{
+    if (sim == NULL)
+    {
+        return;
+    }
+    galsim_unload(sim);
+    free(sim);
+}
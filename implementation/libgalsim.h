@@ -0,0 +1,159 @@
+#ifndef _libgalsim_h
+#define _libgalsim_h
+
+#include "particles.h"
+
+/*
+ * The simulation engine of galsim as a library, for programs that run
+ * many simulations or want to look at the state between steps without
+ * spawning a process per run. A typical use is
+ *
+ *     GalsimConfig config;
+ *     galsim_default_config(&config);
+ *     config.kernel = "tiled";
+ *     config.delta_t = 1e-5;
+ *     Galsim *sim = galsim_create(&config);
+ *     galsim_load(sim, N, "input_data/ellipse_N_03000.gal");
+ *     galsim_step(sim, 100);
+ *     galsim_save(sim, "result.gal");
+ *     galsim_destroy(sim);
+ */
+
+/*
+ * Settings of a simulation. kernel is any name accepted by
+ * force_kernel_from_name, or "auto" to time the exact kernels on every
+ * galsim_load and keep the fastest. integrator is "euler" (the symplectic
+ * Euler of galsim) or "leapfrog" (kick-drift-kick). theta applies to
+ * barnes-hut and fmm, fmm_order and threads to fmm, pm_grid to pm
+ * (0 = automatic). With verbose set, galsim_load prints the calibration
+ * and the kernel in use like the galsim command.
+ */
+typedef struct
+{
+    const char *kernel;
+    const char *integrator;
+    double delta_t;
+    double epsilon;
+    double theta;
+    int fmm_order;
+    int threads;
+    int pm_grid;
+    int verbose;
+} GalsimConfig;
+
+// A simulation; the fields are private to libgalsim.c so that the header needs nothing but particles.h
+typedef struct Galsim Galsim;
+
+// Called by galsim_step before every step with the step about to be taken, counted from the load
+typedef void (*GalsimStepHook)(Particles *particles, long step, void *data);
+
+/*
+ * Function: galsim_default_config
+ * Usage: galsim_default_config(&config);
+ * --------------------------------------
+ * Fills config with the defaults of the galsim command: the simd kernel,
+ * symplectic Euler, delta_t = 1e-5, epsilon = 0.001, theta = 0.5, FMM order
+ * 6 on one thread, an automatic PM grid and no output.
+ */
+void galsim_default_config(GalsimConfig *config);
+
+/*
+ * Function: galsim_create
+ * Usage: Galsim *sim = galsim_create(&config);
+ * --------------------------------------------
+ * Creates a simulation with the given settings, or the defaults if config
+ * is NULL. Returns NULL if the kernel or integrator name is unknown or a
+ * numeric setting is out of range.
+ */
+Galsim *galsim_create(const GalsimConfig *config);
+
+/*
+ * Function: galsim_load
+ * Usage: if (galsim_load(sim, N, "input.gal") != 0) ...
+ * -----------------------------------------------------
+ * Loads N particles from a .gal or .gsnap file, replacing any earlier
+ * state, and prepares the force kernel for them. Returns 0 on success and
+ * -1 on failure, leaving the simulation empty.
+ */
+int galsim_load(Galsim *sim, int N, const char *filename);
+
+/*
+ * Function: galsim_step
+ * Usage: galsim_step(sim, 100);
+ * -----------------------------
+ * Advances the loaded particles by nsteps steps of delta_t. The leapfrog
+ * merges the closing half kick of a step with the opening half kick of
+ * the next one, so a single call with many steps is cheaper than many
+ * calls with one step, and it also rounds differently. Velocities are
+ * brought back to the positions' time before the call returns. Returns 0,
+ * or -1 if nothing is loaded.
+ */
+int galsim_step(Galsim *sim, int nsteps);
+
+/*
+ * Function: galsim_set_step_hook
+ * Usage: galsim_set_step_hook(sim, reorder_hook, reorder);
+ * --------------------------------------------------------
+ * Makes galsim_step call hook(particles, step, data) before every step, or
+ * no function if hook is NULL. The hook may permute all particle arrays
+ * together, as reorder_step does, but should not change the values.
+ */
+void galsim_set_step_hook(Galsim *sim, GalsimStepHook hook, void *data);
+
+/*
+ * Function: galsim_get_state
+ * Usage: const Particles *state = galsim_get_state(sim);
+ * ------------------------------------------------------
+ * Returns the current particles, valid until the next call that changes
+ * the simulation, or NULL if nothing is loaded. Positions and velocities
+ * always refer to the same time, also with the leapfrog integrator.
+ */
+const Particles *galsim_get_state(const Galsim *sim);
+
+/*
+ * Function: galsim_get_particles
+ * Usage: Particles *particles = galsim_get_particles(sim);
+ * --------------------------------------------------------
+ * Like galsim_get_state, for callers that permute the arrays between
+ * steps, as reorder_restore does, or hand them to code that takes a
+ * non-const Particles.
+ */
+Particles *galsim_get_particles(Galsim *sim);
+
+/*
+ * Function: galsim_save
+ * Usage: galsim_save(sim, "result.gal");
+ * --------------------------------------
+ * Writes the current state like save_particles. Returns 0 on success and
+ * -1 on failure.
+ */
+int galsim_save(const Galsim *sim, const char *filename);
+
+/*
+ * Function: galsim_kernel_name
+ * Usage: printf("%s\n", galsim_kernel_name(sim));
+ * -----------------------------------------------
+ * The kernel in use, including the instruction set picked at run time
+ * for simd, tiled and mixed once particles are loaded.
+ */
+const char *galsim_kernel_name(const Galsim *sim);
+
+/*
+ * Function: galsim_particle_count
+ * Usage: int N = galsim_particle_count(sim);
+ * ------------------------------------------
+ * The number of loaded particles, 0 if nothing is loaded.
+ */
+int galsim_particle_count(const Galsim *sim);
+
+/*
+ * Function: galsim_step_count
+ * Usage: long step = galsim_step_count(sim);
+ * ------------------------------------------
+ * The number of steps taken since the particles were loaded.
+ */
+long galsim_step_count(const Galsim *sim);
+
+void galsim_destroy(Galsim *sim);
+
+#endif
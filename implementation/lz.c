@@ -0,0 +1,166 @@
+#include <string.h>
+#include "lz.h"
+
+#define MIN_MATCH 4
+#define MAX_OFFSET 65535
+#define HASH_BITS 14
+
+static uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static uint32_t hash32(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Writes the part of a length that does not fit in its nibble
+static size_t put_length(uint8_t *out, size_t op, size_t length)
+{
+    while (length >= 255)
+    {
+        out[op++] = 255;
+        length -= 255;
+    }
+    out[op++] = (uint8_t)length;
+    return op;
+}
+
+static size_t put_sequence(uint8_t *out, size_t op, const uint8_t *literals, size_t literal_length,
+                           size_t offset, size_t match_length)
+{
+    size_t token = op++;
+    size_t lit_nibble = literal_length < 15 ? literal_length : 15;
+    size_t match_nibble = 0;
+    if (literal_length >= 15)
+    {
+        op = put_length(out, op, literal_length - 15);
+    }
+    memcpy(out + op, literals, literal_length);
+    op += literal_length;
+
+    if (match_length > 0)
+    {
+        out[op++] = (uint8_t)(offset & 0xff);
+        out[op++] = (uint8_t)(offset >> 8);
+        match_nibble = match_length - MIN_MATCH < 15 ? match_length - MIN_MATCH : 15;
+        if (match_length - MIN_MATCH >= 15)
+        {
+            op = put_length(out, op, match_length - MIN_MATCH - 15);
+        }
+    }
+    out[token] = (uint8_t)((lit_nibble << 4) | match_nibble);
+    return op;
+}
+
+size_t lz_bound(size_t n)
+{
+    return n + n / 255 + 16;
+}
+
+size_t lz_compress(const uint8_t *in, size_t n, uint8_t *out)
+{
+    int32_t table[1 << HASH_BITS];
+    memset(table, 0xff, sizeof(table));
+
+    size_t ip = 0, anchor = 0, op = 0;
+    while (ip + MIN_MATCH <= n)
+    {
+        uint32_t sequence = read32(in + ip);
+        uint32_t h = hash32(sequence);
+        int32_t ref = table[h];
+        table[h] = (int32_t)ip;
+
+        if (ref >= 0 && ip - ref <= MAX_OFFSET && read32(in + ref) == sequence)
+        {
+            size_t length = MIN_MATCH;
+            while (ip + length < n && in[ref + length] == in[ip + length])
+            {
+                length++;
+            }
+            op = put_sequence(out, op, in + anchor, ip - anchor, ip - ref, length);
+            ip += length;
+            anchor = ip;
+        }
+        else
+        {
+            ip++;
+        }
+    }
+
+    // Whatever is left goes out as a literal-only sequence, which also marks the end
+    return put_sequence(out, op, in + anchor, n - anchor, 0, 0);
+}
+
+// Reads an extended length, returns -1 if the stream ends inside it
+static int get_length(const uint8_t *in, size_t in_size, size_t *ip, size_t *length)
+{
+    uint8_t b;
+    do
+    {
+        if (*ip >= in_size)
+        {
+            return -1;
+        }
+        b = in[(*ip)++];
+        *length += b;
+    } while (b == 255);
+    return 0;
+}
+
+int lz_decompress(const uint8_t *in, size_t in_size, uint8_t *out, size_t n)
+{
+    size_t ip = 0, op = 0;
+
+    while (ip < in_size)
+    {
+        uint8_t token = in[ip++];
+        size_t literal_length = token >> 4;
+        if (literal_length == 15 && get_length(in, in_size, &ip, &literal_length) != 0)
+        {
+            return -1;
+        }
+        if (literal_length > in_size - ip || literal_length > n - op)
+        {
+            return -1;
+        }
+        memcpy(out + op, in + ip, literal_length);
+        ip += literal_length;
+        op += literal_length;
+
+        if (ip == in_size)
+        {
+            break;
+        }
+
+        if (in_size - ip < 2)
+        {
+            return -1;
+        }
+        size_t offset = in[ip] | ((size_t)in[ip + 1] << 8);
+        ip += 2;
+        size_t match_length = token & 15;
+        if (match_length == 15 && get_length(in, in_size, &ip, &match_length) != 0)
+        {
+            return -1;
+        }
+        match_length += MIN_MATCH;
+        if (offset == 0 || offset > op || match_length > n - op)
+        {
+            return -1;
+        }
+
+        // Byte by byte, because the match may overlap the bytes it produces
+        const uint8_t *match = out + op - offset;
+        for (size_t k = 0; k < match_length; k++)
+        {
+            out[op + k] = match[k];
+        }
+        op += match_length;
+    }
+
+    return op == n ? 0 : -1;
+}
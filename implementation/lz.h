@@ -0,0 +1,42 @@
+#ifndef _lz_h
+#define _lz_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * A small byte-oriented LZ77 codec in the style of LZ4. The stream is a
+ * sequence of (literal run, match) pairs. Each pair starts with a token
+ * byte holding the literal length in the high nibble and the match
+ * length - 4 in the low nibble. A nibble of 15 is extended by following
+ * bytes that are added until one is below 255. The literals follow, then
+ * a two-byte little endian match offset. The last pair has literals only.
+ */
+
+/*
+ * Function: lz_bound
+ * Usage: uint8_t *out = malloc(lz_bound(n));
+ * ------------------------------------------
+ * Largest possible compressed size of n input bytes.
+ */
+size_t lz_bound(size_t n);
+
+/*
+ * Function: lz_compress
+ * Usage: size_t packed = lz_compress(in, n, out);
+ * -----------------------------------------------
+ * Compresses n bytes into out, which must hold lz_bound(n) bytes, and
+ * returns the compressed size.
+ */
+size_t lz_compress(const uint8_t *in, size_t n, uint8_t *out);
+
+/*
+ * Function: lz_decompress
+ * Usage: if (lz_decompress(in, packed, out, n) != 0) ...
+ * ------------------------------------------------------
+ * Expands a stream made by lz_compress that must decode to exactly n
+ * bytes. Returns 0 on success and -1 if the stream is corrupt.
+ */
+int lz_decompress(const uint8_t *in, size_t in_size, uint8_t *out, size_t n);
+
+#endif
@@ -0,0 +1,218 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "mixed_kernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_DISPATCH 1
+#endif
+
+// Keeps rsqrt finite for the j == i term, whose r_ij is exactly zero
+#define R2_FLOOR 1e-30f
+
+FloatParticles *float_particles_create(const Particles *particles, int N)
+{
+    FloatParticles *fparticles = malloc(sizeof(FloatParticles));
+    fparticles->N = N;
+    fparticles->posx = malloc(N * sizeof(float));
+    fparticles->posy = malloc(N * sizeof(float));
+    fparticles->mass = malloc(N * sizeof(float));
+    float_particles_update(fparticles, particles);
+    return fparticles;
+}
+
+void float_particles_update(FloatParticles *fparticles, const Particles *particles)
+{
+    for (int i = 0; i < fparticles->N; i++)
+    {
+        fparticles->posx[i] = (float)particles->posx[i];
+        fparticles->posy[i] = (float)particles->posy[i];
+        fparticles->mass[i] = (float)particles->mass[i];
+    }
+}
+
+void float_particles_destroy(FloatParticles *fparticles)
+{
+    free(fparticles->posx);
+    free(fparticles->posy);
+    free(fparticles->mass);
+    free(fparticles);
+}
+
+static void update_acceleration_mixed_scalar(const FloatParticles *fparticles, Particles *particles, double epsilon)
+{
+    const int N = fparticles->N;
+    const float eps = (float)epsilon;
+
+    for (int i = 0; i < N; i++)
+    {
+        const float xi = fparticles->posx[i];
+        const float yi = fparticles->posy[i];
+        double aXi = 0.0;
+        double aYi = 0.0;
+        for (int j = 0; j < N; j++)
+        {
+            float rx = xi - fparticles->posx[j];
+            float ry = yi - fparticles->posy[j];
+            float rr = sqrtf(rx * rx + ry * ry) + eps;
+            float div_1_rr = fparticles->mass[j] / (rr * rr * rr);
+            aXi += (double)(rx * div_1_rr);
+            aYi += (double)(ry * div_1_rr);
+        }
+        particles->accx[i] = aXi;
+        particles->accy[i] = aYi;
+    }
+}
+
+#ifdef HAVE_X86_DISPATCH
+
+static void add_remainder(const FloatParticles *fparticles, int i, int j, float eps, double *aXi, double *aYi)
+{
+    for (; j < fparticles->N; j++)
+    {
+        float rx = fparticles->posx[i] - fparticles->posx[j];
+        float ry = fparticles->posy[i] - fparticles->posy[j];
+        float rr = sqrtf(rx * rx + ry * ry) + eps;
+        float div_1_rr = fparticles->mass[j] / (rr * rr * rr);
+        *aXi += (double)(rx * div_1_rr);
+        *aYi += (double)(ry * div_1_rr);
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void update_acceleration_mixed_avx2(const FloatParticles *fparticles, Particles *particles, double epsilon)
+{
+    const int N = fparticles->N;
+    const __m256 eps = _mm256_set1_ps((float)epsilon);
+    const __m256 r2_floor = _mm256_set1_ps(R2_FLOOR);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 three_halves = _mm256_set1_ps(1.5f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+
+    for (int i = 0; i < N; i++)
+    {
+        const __m256 xi = _mm256_set1_ps(fparticles->posx[i]);
+        const __m256 yi = _mm256_set1_ps(fparticles->posy[i]);
+        __m256d ax = _mm256_setzero_pd();
+        __m256d ay = _mm256_setzero_pd();
+
+        int j = 0;
+        for (; j + 8 <= N; j += 8)
+        {
+            __m256 rx = _mm256_sub_ps(xi, _mm256_loadu_ps(fparticles->posx + j));
+            __m256 ry = _mm256_sub_ps(yi, _mm256_loadu_ps(fparticles->posy + j));
+            __m256 r2 = _mm256_fmadd_ps(rx, rx, _mm256_fmadd_ps(ry, ry, r2_floor));
+
+            // r = r2 / sqrt(r2) from a refined reciprocal square root
+            __m256 y = _mm256_rsqrt_ps(r2);
+            y = _mm256_mul_ps(y, _mm256_fnmadd_ps(_mm256_mul_ps(half, r2), _mm256_mul_ps(y, y), three_halves));
+            __m256 rr = _mm256_fmadd_ps(r2, y, eps);
+
+            // 1 / rr^3 from a refined reciprocal
+            __m256 rr3 = _mm256_mul_ps(rr, _mm256_mul_ps(rr, rr));
+            __m256 inv = _mm256_rcp_ps(rr3);
+            inv = _mm256_mul_ps(inv, _mm256_fnmadd_ps(rr3, inv, two));
+            __m256 div_1_rr = _mm256_mul_ps(_mm256_loadu_ps(fparticles->mass + j), inv);
+
+            // Widen the eight float terms to double before accumulating
+            __m256 fx = _mm256_mul_ps(rx, div_1_rr);
+            __m256 fy = _mm256_mul_ps(ry, div_1_rr);
+            ax = _mm256_add_pd(ax, _mm256_cvtps_pd(_mm256_castps256_ps128(fx)));
+            ax = _mm256_add_pd(ax, _mm256_cvtps_pd(_mm256_extractf128_ps(fx, 1)));
+            ay = _mm256_add_pd(ay, _mm256_cvtps_pd(_mm256_castps256_ps128(fy)));
+            ay = _mm256_add_pd(ay, _mm256_cvtps_pd(_mm256_extractf128_ps(fy, 1)));
+        }
+
+        __m128d sx = _mm_add_pd(_mm256_castpd256_pd128(ax), _mm256_extractf128_pd(ax, 1));
+        __m128d sy = _mm_add_pd(_mm256_castpd256_pd128(ay), _mm256_extractf128_pd(ay, 1));
+        double aXi = _mm_cvtsd_f64(_mm_add_sd(sx, _mm_unpackhi_pd(sx, sx)));
+        double aYi = _mm_cvtsd_f64(_mm_add_sd(sy, _mm_unpackhi_pd(sy, sy)));
+
+        add_remainder(fparticles, i, j, (float)epsilon, &aXi, &aYi);
+        particles->accx[i] = aXi;
+        particles->accy[i] = aYi;
+    }
+}
+
+__attribute__((target("avx512f")))
+static void update_acceleration_mixed_avx512(const FloatParticles *fparticles, Particles *particles, double epsilon)
+{
+    const int N = fparticles->N;
+    const __m512 eps = _mm512_set1_ps((float)epsilon);
+    const __m512 r2_floor = _mm512_set1_ps(R2_FLOOR);
+    const __m512 half = _mm512_set1_ps(0.5f);
+    const __m512 three_halves = _mm512_set1_ps(1.5f);
+    const __m512 two = _mm512_set1_ps(2.0f);
+
+    for (int i = 0; i < N; i++)
+    {
+        const __m512 xi = _mm512_set1_ps(fparticles->posx[i]);
+        const __m512 yi = _mm512_set1_ps(fparticles->posy[i]);
+        __m512d ax = _mm512_setzero_pd();
+        __m512d ay = _mm512_setzero_pd();
+
+        int j = 0;
+        for (; j + 16 <= N; j += 16)
+        {
+            __m512 rx = _mm512_sub_ps(xi, _mm512_loadu_ps(fparticles->posx + j));
+            __m512 ry = _mm512_sub_ps(yi, _mm512_loadu_ps(fparticles->posy + j));
+            __m512 r2 = _mm512_fmadd_ps(rx, rx, _mm512_fmadd_ps(ry, ry, r2_floor));
+
+            __m512 y = _mm512_rsqrt14_ps(r2);
+            y = _mm512_mul_ps(y, _mm512_fnmadd_ps(_mm512_mul_ps(half, r2), _mm512_mul_ps(y, y), three_halves));
+            __m512 rr = _mm512_fmadd_ps(r2, y, eps);
+
+            __m512 rr3 = _mm512_mul_ps(rr, _mm512_mul_ps(rr, rr));
+            __m512 inv = _mm512_rcp14_ps(rr3);
+            inv = _mm512_mul_ps(inv, _mm512_fnmadd_ps(rr3, inv, two));
+            __m512 div_1_rr = _mm512_mul_ps(_mm512_loadu_ps(fparticles->mass + j), inv);
+
+            __m512 fx = _mm512_mul_ps(rx, div_1_rr);
+            __m512 fy = _mm512_mul_ps(ry, div_1_rr);
+            ax = _mm512_add_pd(ax, _mm512_cvtps_pd(_mm512_castps512_ps256(fx)));
+            ax = _mm512_add_pd(ax, _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(fx), 1))));
+            ay = _mm512_add_pd(ay, _mm512_cvtps_pd(_mm512_castps512_ps256(fy)));
+            ay = _mm512_add_pd(ay, _mm512_cvtps_pd(_mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(fy), 1))));
+        }
+
+        double aXi = _mm512_reduce_add_pd(ax);
+        double aYi = _mm512_reduce_add_pd(ay);
+
+        add_remainder(fparticles, i, j, (float)epsilon, &aXi, &aYi);
+        particles->accx[i] = aXi;
+        particles->accy[i] = aYi;
+    }
+}
+
+#endif
+
+MixedAccelerationKernel select_mixed_kernel(const char **name)
+{
+    MixedAccelerationKernel kernel = update_acceleration_mixed_scalar;
+    const char *kernel_name = "scalar mixed precision";
+
+#ifdef HAVE_X86_DISPATCH
+    const char *limit = getenv("GALSIM_SIMD");
+    int allow_avx512 = limit == NULL || strcmp(limit, "avx512") == 0;
+    int allow_avx2 = allow_avx512 || strcmp(limit, "avx2") == 0;
+
+    __builtin_cpu_init();
+    if (allow_avx512 && __builtin_cpu_supports("avx512f"))
+    {
+        kernel = update_acceleration_mixed_avx512;
+        kernel_name = "avx512 mixed precision";
+    }
+    else if (allow_avx2 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        kernel = update_acceleration_mixed_avx2;
+        kernel_name = "avx2 mixed precision";
+    }
+#endif
+
+    if (name != NULL)
+    {
+        *name = kernel_name;
+    }
+    return kernel;
+}
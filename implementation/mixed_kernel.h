@@ -0,0 +1,49 @@
+#ifndef _mixed_kernel_h
+#define _mixed_kernel_h
+
+#include "particles.h"
+
+/*
+ * Single precision copies of the fields the force loop reads. The master
+ * positions and velocities stay in double in Particles; these are
+ * refreshed from them once per step.
+ */
+typedef struct
+{
+    float *posx;
+    float *posy;
+    float *mass;
+    int N;
+} FloatParticles;
+
+/*
+ * Evaluates the pairwise terms in float and accumulates accx/accy in
+ * double. Same contract as AccelerationKernel in simd_kernel.h.
+ */
+typedef void (*MixedAccelerationKernel)(const FloatParticles *fparticles, Particles *particles, double epsilon);
+
+FloatParticles *float_particles_create(const Particles *particles, int N);
+
+/*
+ * Function: float_particles_update
+ * Usage: float_particles_update(fparticles, particles);
+ * -----------------------------------------------------
+ * Rounds the current double positions and masses to float. Masses are
+ * refreshed too because a reorder pass may have permuted them.
+ */
+void float_particles_update(FloatParticles *fparticles, const Particles *particles);
+
+void float_particles_destroy(FloatParticles *fparticles);
+
+/*
+ * Function: select_mixed_kernel
+ * Usage: MixedAccelerationKernel kernel = select_mixed_kernel(&name);
+ * -------------------------------------------------------------------
+ * AVX-512 (16 float lanes) or AVX2 (8 float lanes) using the hardware
+ * reciprocal square root and reciprocal with one Newton-Raphson step
+ * each, or a plain float fallback. GALSIM_SIMD caps the choice as for
+ * select_acceleration_kernel.
+ */
+MixedAccelerationKernel select_mixed_kernel(const char **name);
+
+#endif
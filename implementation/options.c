@@ -0,0 +1,50 @@
+#include <string.h>
+#include "options.h"
+
+// Removes count entries starting at index, keeping argv NULL-terminated
+static int remove_args(int argc, char *argv[], int index, int count)
+{
+    for (int i = index; i + count <= argc; i++)
+    {
+        argv[i] = argv[i + count];
+    }
+    return argc - count;
+}
+
+int extract_option(int argc, char *argv[], const char *name, const char **value)
+{
+    size_t length = strlen(name);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], name, length) != 0)
+        {
+            continue;
+        }
+        if (argv[i][length] == '=')
+        {
+            *value = argv[i] + length + 1;
+            return remove_args(argc, argv, i, 1);
+        }
+        if (argv[i][length] == '\0' && i + 1 < argc)
+        {
+            *value = argv[i + 1];
+            return remove_args(argc, argv, i, 2);
+        }
+    }
+    return argc;
+}
+
+int extract_flag(int argc, char *argv[], const char *name, int *present)
+{
+    *present = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], name) == 0)
+        {
+            *present = 1;
+            return remove_args(argc, argv, i, 1);
+        }
+    }
+    return argc;
+}
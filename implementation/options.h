@@ -0,0 +1,24 @@
+#ifndef _options_h
+#define _options_h
+
+/*
+ * Function: extract_option
+ * Usage: argc = extract_option(argc, argv, "--output", &output_file);
+ * -------------------------------------------------------------------
+ * Looks for "--name value" or "--name=value" anywhere in argv. If it is
+ * found, *value is set and the option is removed from argv so that the
+ * positional arguments keep their usual indices. *value is left untouched
+ * otherwise. Returns the new argc.
+ */
+int extract_option(int argc, char *argv[], const char *name, const char **value);
+
+/*
+ * Function: extract_flag
+ * Usage: argc = extract_flag(argc, argv, "--restart", &restart);
+ * --------------------------------------------------------------
+ * Same as extract_option for an option without a value. *present is set
+ * to 1 if the flag was given and 0 otherwise.
+ */
+int extract_flag(int argc, char *argv[], const char *name, int *present);
+
+#endif
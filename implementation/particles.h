@@ -0,0 +1,27 @@
+#ifndef _particles_h
+#define _particles_h
+
+#include <stddef.h>
+
+/*
+ * Structure-of-arrays storage for all the stars in a galaxy. Every array
+ * holds one entry per particle, in the order of the input .gal file.
+ */
+typedef struct
+{
+    double *posx;
+    double *posy;
+    double *mass;
+    double *velx;
+    double *vely;
+    double *accx;
+    double *accy;
+    double *brightness;
+    // Non-NULL when the arrays point into a mapped .gsnap file, see free_particles
+    void *mapping;
+    size_t mapping_bytes;
+    // Owns every array that is not part of the mapping, plus the run's scratch space
+    struct Arena *arena;
+} Particles;
+
+#endif
@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "pm.h"
+
+// Headroom left when the spacing is (re)chosen, so the kernel is not rebuilt every step
+#define SPACING_MARGIN 1.25
+
+static void bounding_box(const Particles *particles, int N, double *cx, double *cy, double *extent)
+{
+    double min_x = particles->posx[0], max_x = particles->posx[0];
+    double min_y = particles->posy[0], max_y = particles->posy[0];
+    for (int i = 1; i < N; i++)
+    {
+        min_x = fmin(min_x, particles->posx[i]);
+        max_x = fmax(max_x, particles->posx[i]);
+        min_y = fmin(min_y, particles->posy[i]);
+        max_y = fmax(max_y, particles->posy[i]);
+    }
+    *cx = 0.5 * (min_x + max_x);
+    *cy = 0.5 * (min_y + max_y);
+    *extent = fmax(max_x - min_x, max_y - min_y);
+}
+
+// Transforms the force kernel for the current spacing; offsets of M or more wrap around to negative ones
+static void build_kernel(PmSolver *pm)
+{
+    const int M = pm->grid;
+    const int P = 2 * M;
+    for (int j = 0; j < P; j++)
+    {
+        int dj = j < M ? j : j - P;
+        for (int i = 0; i < P; i++)
+        {
+            int di = i < M ? i : i - P;
+            double *k = pm->kernel + 2 * ((size_t)j * P + i);
+            if (di == -M || dj == -M || (di == 0 && dj == 0))
+            {
+                k[0] = k[1] = 0.0;
+                continue;
+            }
+            double rx = di * pm->h;
+            double ry = dj * pm->h;
+            double rr = sqrt(rx * rx + ry * ry) + pm->epsilon;
+            double div_1_rr = 1 / (rr * rr * rr);
+            k[0] = rx * div_1_rr;
+            k[1] = ry * div_1_rr;
+        }
+    }
+    fft_2d(pm->plan, pm->kernel, 0);
+}
+
+// Cloud-in-cell weights of the four grid points around a particle
+static void cic(const PmSolver *pm, double x, double y, int *i, int *j, double *fx, double *fy)
+{
+    double u = (x - pm->x0) / pm->h;
+    double v = (y - pm->y0) / pm->h;
+    *i = (int)floor(u);
+    *j = (int)floor(v);
+    *fx = u - *i;
+    *fy = v - *j;
+}
+
+PmSolver *pm_create(const Particles *particles, int N, int grid, double epsilon)
+{
+    double cx, cy, extent;
+    bounding_box(particles, N, &cx, &cy, &extent);
+    if (grid == 0)
+    {
+        grid = 64;
+        while (grid < PM_MAX_AUTO_GRID && extent * SPACING_MARGIN / (grid - 2) > epsilon)
+        {
+            grid *= 2;
+        }
+    }
+    if (grid < 4 || (grid & (grid - 1)) != 0)
+    {
+        printf("The particle-mesh grid must be a power of two and at least 4.\n");
+        return NULL;
+    }
+
+    PmSolver *pm = malloc(sizeof(PmSolver));
+    const size_t cells = (size_t)4 * grid * grid;
+    pm->N = N;
+    pm->grid = grid;
+    pm->epsilon = epsilon;
+    pm->h = 0.0;
+    pm->plan = fft_plan_create(2 * grid);
+    pm->density = malloc(cells * 2 * sizeof(double));
+    pm->kernel = malloc(cells * 2 * sizeof(double));
+    return pm;
+}
+
+void update_acceleration_pm(PmSolver *pm, Particles *particles)
+{
+    const int N = pm->N;
+    const int M = pm->grid;
+    const int P = 2 * M;
+    if (N == 0)
+    {
+        return;
+    }
+
+    // Grid points 0..M-1 must enclose every particle together with its right and upper CIC neighbours
+    double cx, cy, extent;
+    bounding_box(particles, N, &cx, &cy, &extent);
+    double needed = fmax(extent, 1e-300) / (M - 2);
+    if (pm->h < needed || pm->h > 4.0 * SPACING_MARGIN * needed)
+    {
+        pm->h = SPACING_MARGIN * needed;
+        build_kernel(pm);
+    }
+    pm->x0 = cx - 0.5 * (M - 1) * pm->h;
+    pm->y0 = cy - 0.5 * (M - 1) * pm->h;
+
+    memset(pm->density, 0, (size_t)P * P * 2 * sizeof(double));
+    for (int n = 0; n < N; n++)
+    {
+        int i, j;
+        double fx, fy;
+        cic(pm, particles->posx[n], particles->posy[n], &i, &j, &fx, &fy);
+        double m = particles->mass[n];
+        double *row0 = pm->density + 2 * ((size_t)j * P + i);
+        double *row1 = row0 + 2 * P;
+        row0[0] += m * (1 - fx) * (1 - fy);
+        row0[2] += m * fx * (1 - fy);
+        row1[0] += m * (1 - fx) * fy;
+        row1[2] += m * fx * fy;
+    }
+
+    // Both kernels are real, so x and y come back as the real and imaginary parts
+    fft_2d(pm->plan, pm->density, 0);
+    for (size_t c = 0; c < (size_t)P * P; c++)
+    {
+        double re = pm->density[2 * c], im = pm->density[2 * c + 1];
+        double kr = pm->kernel[2 * c], ki = pm->kernel[2 * c + 1];
+        pm->density[2 * c] = re * kr - im * ki;
+        pm->density[2 * c + 1] = re * ki + im * kr;
+    }
+    fft_2d(pm->plan, pm->density, 1);
+
+    const double scale = 1.0 / ((double)P * P);
+    for (int n = 0; n < N; n++)
+    {
+        int i, j;
+        double fx, fy;
+        cic(pm, particles->posx[n], particles->posy[n], &i, &j, &fx, &fy);
+        const double *row0 = pm->density + 2 * ((size_t)j * P + i);
+        const double *row1 = row0 + 2 * P;
+        double w00 = (1 - fx) * (1 - fy), w10 = fx * (1 - fy), w01 = (1 - fx) * fy, w11 = fx * fy;
+        particles->accx[n] = scale * (w00 * row0[0] + w10 * row0[2] + w01 * row1[0] + w11 * row1[2]);
+        particles->accy[n] = scale * (w00 * row0[1] + w10 * row0[3] + w01 * row1[1] + w11 * row1[3]);
+    }
+}
+
+void pm_destroy(PmSolver *pm)
+{
+    fft_plan_destroy(pm->plan);
+    free(pm->density);
+    free(pm->kernel);
+    free(pm);
+}
@@ -0,0 +1,57 @@
+#ifndef _pm_h
+#define _pm_h
+
+#include "particles.h"
+#include "fft.h"
+
+// Largest grid the automatic choice picks, larger grids have to be asked for
+#define PM_MAX_AUTO_GRID 1024
+
+/*
+ * Particle-mesh solver. Masses are assigned to an M x M grid with
+ * cloud-in-cell weights. The grid is convolved with the softened force
+ * kernel r / (|r| + epsilon)^3 through FFTs on a zero-padded 2M x 2M grid,
+ * so the galaxy sees no periodic images. The forces are then interpolated
+ * back with the same weights. The x and y kernels are packed into the real
+ * and imaginary parts of one complex grid, so a step needs one forward
+ * and one inverse transform.
+ */
+typedef struct
+{
+    int N;
+    int grid;
+    double epsilon;
+    // Grid spacing the kernel was built for, and the position of grid point (0, 0)
+    double h;
+    double x0;
+    double y0;
+    FftPlan *plan;
+    double *density;
+    double *kernel;
+} PmSolver;
+
+/*
+ * Function: pm_create
+ * Usage: PmSolver *pm = pm_create(particles, N, 0, epsilon);
+ * ----------------------------------------------------------
+ * grid is the number of grid points per side and must be a power of two.
+ * With grid = 0 it is chosen so that the spacing over the initial extent
+ * of the particles is about epsilon, since the grid cannot resolve forces
+ * below its own spacing anyway. The choice is capped at PM_MAX_AUTO_GRID.
+ * Returns NULL if grid is not a power of two.
+ */
+PmSolver *pm_create(const Particles *particles, int N, int grid, double epsilon);
+
+/*
+ * Function: update_acceleration_pm
+ * Usage: update_acceleration_pm(pm, particles);
+ * ---------------------------------------------
+ * Fills accx/accy. The grid follows the particles, and the kernel is only
+ * rebuilt when their extent no longer fits the current spacing or has
+ * shrunk well below it.
+ */
+void update_acceleration_pm(PmSolver *pm, Particles *particles);
+
+void pm_destroy(PmSolver *pm);
+
+#endif
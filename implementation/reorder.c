@@ -0,0 +1,295 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "reorder.h"
+
+// Positions are quantized to 16 bits per axis, so keys fit in 32 bits and sort in four 8-bit passes
+#define KEY_BITS 16
+#define RADIX 256
+
+typedef struct
+{
+    Reorder *reorder;
+    int thread_id;
+} ReorderTask;
+
+static void thread_range(const Reorder *reorder, int t, int *begin, int *end)
+{
+    *begin = (int)((long)reorder->N * t / reorder->pool->thread_count);
+    *end = (int)((long)reorder->N * (t + 1) / reorder->pool->thread_count);
+}
+
+// Spreads the 16 bits of v over the even bits of the result
+static uint32_t spread_bits(uint32_t v)
+{
+    v = (v | (v << 8)) & 0x00ff00ffu;
+    v = (v | (v << 4)) & 0x0f0f0f0fu;
+    v = (v | (v << 2)) & 0x33333333u;
+    v = (v | (v << 1)) & 0x55555555u;
+    return v;
+}
+
+static uint32_t morton_key(uint32_t x, uint32_t y)
+{
+    return spread_bits(x) | (spread_bits(y) << 1);
+}
+
+// Distance along the Hilbert curve of order KEY_BITS, rotating the quadrant frame at each level
+static uint32_t hilbert_key(uint32_t x, uint32_t y)
+{
+    uint32_t d = 0;
+    for (uint32_t s = 1u << (KEY_BITS - 1); s > 0; s >>= 1)
+    {
+        uint32_t rx = (x & s) ? 1 : 0;
+        uint32_t ry = (y & s) ? 1 : 0;
+        d += s * s * ((3 * rx) ^ ry);
+        if (ry == 0)
+        {
+            if (rx == 1)
+            {
+                x = s - 1 - x;
+                y = s - 1 - y;
+            }
+            uint32_t t = x;
+            x = y;
+            y = t;
+        }
+    }
+    return d;
+}
+
+static void *compute_keys(void *arg)
+{
+    ReorderTask *task = (ReorderTask *)arg;
+    Reorder *reorder = task->reorder;
+    const Particles *particles = reorder->particles;
+    const uint32_t max_cell = (1u << KEY_BITS) - 1;
+    int begin, end;
+    thread_range(reorder, task->thread_id, &begin, &end);
+
+    for (int i = begin; i < end; i++)
+    {
+        double u = (particles->posx[i] - reorder->min_x) * reorder->scale;
+        double v = (particles->posy[i] - reorder->min_y) * reorder->scale;
+        uint32_t x = u < max_cell ? (uint32_t)u : max_cell;
+        uint32_t y = v < max_cell ? (uint32_t)v : max_cell;
+        reorder->keys[0][i] = reorder->curve == CURVE_HILBERT ? hilbert_key(x, y) : morton_key(x, y);
+        reorder->perm[0][i] = i;
+    }
+    return NULL;
+}
+
+static void *count_digits(void *arg)
+{
+    ReorderTask *task = (ReorderTask *)arg;
+    Reorder *reorder = task->reorder;
+    int *histogram = reorder->histogram + task->thread_id * RADIX;
+    int begin, end;
+    thread_range(reorder, task->thread_id, &begin, &end);
+
+    memset(histogram, 0, RADIX * sizeof(int));
+    for (int k = begin; k < end; k++)
+    {
+        histogram[(reorder->keys[0][k] >> reorder->shift) & (RADIX - 1)]++;
+    }
+    return NULL;
+}
+
+// Each thread moves its own slice to the offsets computed from all histograms, which keeps the sort stable
+static void *scatter_digits(void *arg)
+{
+    ReorderTask *task = (ReorderTask *)arg;
+    Reorder *reorder = task->reorder;
+    int *offset = reorder->histogram + task->thread_id * RADIX;
+    int begin, end;
+    thread_range(reorder, task->thread_id, &begin, &end);
+
+    for (int k = begin; k < end; k++)
+    {
+        uint32_t key = reorder->keys[0][k];
+        int d = offset[(key >> reorder->shift) & (RADIX - 1)]++;
+        reorder->keys[1][d] = key;
+        reorder->perm[1][d] = reorder->perm[0][k];
+    }
+    return NULL;
+}
+
+static void *gather_field(void *arg)
+{
+    ReorderTask *task = (ReorderTask *)arg;
+    Reorder *reorder = task->reorder;
+    int begin, end;
+    thread_range(reorder, task->thread_id, &begin, &end);
+    for (int k = begin; k < end; k++)
+    {
+        reorder->scratch[k] = reorder->field[reorder->perm[0][k]];
+    }
+    return NULL;
+}
+
+static void *scatter_field(void *arg)
+{
+    ReorderTask *task = (ReorderTask *)arg;
+    Reorder *reorder = task->reorder;
+    int begin, end;
+    thread_range(reorder, task->thread_id, &begin, &end);
+    for (int k = begin; k < end; k++)
+    {
+        reorder->scratch[reorder->order[k]] = reorder->field[k];
+    }
+    return NULL;
+}
+
+static void *copy_field(void *arg)
+{
+    ReorderTask *task = (ReorderTask *)arg;
+    Reorder *reorder = task->reorder;
+    int begin, end;
+    thread_range(reorder, task->thread_id, &begin, &end);
+    memcpy(reorder->field + begin, reorder->scratch + begin, (end - begin) * sizeof(double));
+    return NULL;
+}
+
+static void run_phase(Reorder *reorder, void *(*phase)(void *))
+{
+    const int thread_count = reorder->pool->thread_count;
+    ReorderTask tasks[thread_count];
+    for (int t = 0; t < thread_count; t++)
+    {
+        tasks[t].reorder = reorder;
+        tasks[t].thread_id = t;
+    }
+    pool_run(reorder->pool, phase, tasks, sizeof(ReorderTask));
+}
+
+// Applies a gather or scatter to every SoA array, going through the scratch buffer
+static void permute_fields(Reorder *reorder, Particles *particles, void *(*move)(void *))
+{
+    double *fields[8] = {particles->posx, particles->posy, particles->mass, particles->velx,
+                         particles->vely, particles->accx, particles->accy, particles->brightness};
+    for (int f = 0; f < 8; f++)
+    {
+        reorder->field = fields[f];
+        run_phase(reorder, move);
+        run_phase(reorder, copy_field);
+    }
+}
+
+Reorder *reorder_create(int N, int every, int curve, int thread_count)
+{
+    if (every <= 0)
+    {
+        return NULL;
+    }
+
+    Reorder *reorder = malloc(sizeof(Reorder));
+    reorder->N = N;
+    reorder->every = every;
+    reorder->curve = curve;
+    reorder->order = malloc(N * sizeof(int));
+    for (int i = 0; i < N; i++)
+    {
+        reorder->order[i] = i;
+    }
+    for (int b = 0; b < 2; b++)
+    {
+        reorder->keys[b] = malloc(N * sizeof(uint32_t));
+        reorder->perm[b] = malloc(N * sizeof(int));
+    }
+    reorder->int_scratch = malloc(N * sizeof(int));
+    reorder->scratch = malloc(N * sizeof(double));
+    reorder->pool = pool_create(thread_count > 0 ? thread_count : 1);
+    reorder->histogram = malloc((size_t)reorder->pool->thread_count * RADIX * sizeof(int));
+    return reorder;
+}
+
+int reorder_step(Reorder *reorder, Particles *particles, int step)
+{
+    if (reorder == NULL || step % reorder->every != 0 || reorder->N == 0)
+    {
+        return 0;
+    }
+    const int N = reorder->N;
+    const int thread_count = reorder->pool->thread_count;
+
+    double min_x = particles->posx[0], max_x = particles->posx[0];
+    double min_y = particles->posy[0], max_y = particles->posy[0];
+    for (int i = 1; i < N; i++)
+    {
+        min_x = fmin(min_x, particles->posx[i]);
+        max_x = fmax(max_x, particles->posx[i]);
+        min_y = fmin(min_y, particles->posy[i]);
+        max_y = fmax(max_y, particles->posy[i]);
+    }
+    double extent = fmax(max_x - min_x, max_y - min_y);
+    reorder->min_x = min_x;
+    reorder->min_y = min_y;
+    reorder->scale = extent > 0.0 ? (1u << KEY_BITS) / extent : 0.0;
+    reorder->particles = particles;
+    run_phase(reorder, compute_keys);
+
+    // LSD radix sort of (key, index) pairs; an even number of passes leaves the result in buffer 0
+    for (reorder->shift = 0; reorder->shift < 2 * KEY_BITS; reorder->shift += 8)
+    {
+        run_phase(reorder, count_digits);
+
+        int total = 0;
+        for (int d = 0; d < RADIX; d++)
+        {
+            for (int t = 0; t < thread_count; t++)
+            {
+                int count = reorder->histogram[t * RADIX + d];
+                reorder->histogram[t * RADIX + d] = total;
+                total += count;
+            }
+        }
+
+        run_phase(reorder, scatter_digits);
+        uint32_t *keys = reorder->keys[0];
+        reorder->keys[0] = reorder->keys[1];
+        reorder->keys[1] = keys;
+        int *perm = reorder->perm[0];
+        reorder->perm[0] = reorder->perm[1];
+        reorder->perm[1] = perm;
+    }
+
+    permute_fields(reorder, particles, gather_field);
+    for (int k = 0; k < N; k++)
+    {
+        reorder->int_scratch[k] = reorder->order[reorder->perm[0][k]];
+    }
+    memcpy(reorder->order, reorder->int_scratch, N * sizeof(int));
+    return 1;
+}
+
+void reorder_restore(Reorder *reorder, Particles *particles)
+{
+    if (reorder == NULL)
+    {
+        return;
+    }
+    permute_fields(reorder, particles, scatter_field);
+    for (int i = 0; i < reorder->N; i++)
+    {
+        reorder->order[i] = i;
+    }
+}
+
+void reorder_destroy(Reorder *reorder)
+{
+    if (reorder == NULL)
+    {
+        return;
+    }
+    pool_destroy(reorder->pool);
+    free(reorder->order);
+    for (int b = 0; b < 2; b++)
+    {
+        free(reorder->keys[b]);
+        free(reorder->perm[b]);
+    }
+    free(reorder->int_scratch);
+    free(reorder->scratch);
+    free(reorder->histogram);
+    free(reorder);
+}
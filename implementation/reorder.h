@@ -0,0 +1,73 @@
+#ifndef _reorder_h
+#define _reorder_h
+
+#include <stdint.h>
+#include "particles.h"
+#include "thread_pool.h"
+
+#define CURVE_MORTON 0
+#define CURVE_HILBERT 1
+
+/*
+ * Sorts the particles along a space-filling curve every "every" steps, so
+ * that particles close in space are also close in memory. All eight SoA
+ * arrays are permuted. "order" records the original index of the
+ * particle now stored at each position, so the file order can be restored
+ * for output. Every buffer is allocated once by reorder_create.
+ */
+typedef struct
+{
+    int N;
+    int every;
+    int curve;
+    // order[k] is the index in the input file of the particle stored at k
+    int *order;
+    uint32_t *keys[2];
+    int *perm[2];
+    int *int_scratch;
+    double *scratch;
+    // Per-thread digit counts of the current radix pass
+    int *histogram;
+    int shift;
+    // Field being permuted by the gather/copy phases
+    double *field;
+    ThreadPool *pool;
+    // Bounding box of the current positions, for the key quantization
+    double min_x;
+    double min_y;
+    double scale;
+    const Particles *particles;
+} Reorder;
+
+/*
+ * Function: reorder_create
+ * Usage: Reorder *reorder = reorder_create(N, 50, CURVE_HILBERT, thread_count);
+ * -----------------------------------------------------------------------------
+ * Returns NULL when every <= 0, and the other functions accept NULL, so
+ * callers need no special case when reordering is off. The key
+ * computation, the radix sort and the permutation run on thread_count
+ * threads.
+ */
+Reorder *reorder_create(int N, int every, int curve, int thread_count);
+
+/*
+ * Function: reorder_step
+ * Usage: reorder_step(reorder, particles, step);
+ * ----------------------------------------------
+ * Sorts the particles if step is a multiple of the interval. Returns 1 if
+ * it did.
+ */
+int reorder_step(Reorder *reorder, Particles *particles, int step);
+
+/*
+ * Function: reorder_restore
+ * Usage: reorder_restore(reorder, particles);
+ * -------------------------------------------
+ * Puts the particles back in the order of the input file, e.g. before
+ * they are saved.
+ */
+void reorder_restore(Reorder *reorder, Particles *particles);
+
+void reorder_destroy(Reorder *reorder);
+
+#endif
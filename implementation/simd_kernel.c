@@ -0,0 +1,195 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "simd_kernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_DISPATCH 1
+#endif
+
+void accumulate_acceleration_scalar(Particles *particles, int i_start, int i_end, int j_start, int j_end, double epsilon)
+{
+    // Variables needed for calcluations
+    double rx, ry, r, rr, div_1_rr;
+
+    for (int i = i_start; i < i_end; i++)
+    {
+        double aXi = 0.0;
+        double aYi = 0.0;
+        for (int j = j_start; j < j_end; j++)
+        {
+            rx = particles->posx[i] - particles->posx[j];
+            ry = particles->posy[i] - particles->posy[j];
+            r = sqrt(rx * rx + ry * ry);
+            rr = r + epsilon;
+            div_1_rr = particles->mass[j] / (rr * rr * rr);
+            aXi += rx * div_1_rr;
+            aYi += ry * div_1_rr;
+        }
+        particles->accx[i] += aXi;
+        particles->accy[i] += aYi;
+    }
+}
+
+static void clear_acceleration(Particles *particles, int N)
+{
+    for (int i = 0; i < N; i++)
+    {
+        particles->accx[i] = 0.0;
+        particles->accy[i] = 0.0;
+    }
+}
+
+void update_acceleration_scalar(Particles *particles, int N, double epsilon)
+{
+    clear_acceleration(particles, N);
+    accumulate_acceleration_scalar(particles, 0, N, 0, N, epsilon);
+}
+
+#ifdef HAVE_X86_DISPATCH
+
+// Handles the j indices left over after the last full vector
+static void add_remainder(const Particles *particles, int i, int j, int j_end, double epsilon, double *aXi, double *aYi)
+{
+    for (; j < j_end; j++)
+    {
+        double rx = particles->posx[i] - particles->posx[j];
+        double ry = particles->posy[i] - particles->posy[j];
+        double rr = sqrt(rx * rx + ry * ry) + epsilon;
+        double div_1_rr = particles->mass[j] / (rr * rr * rr);
+        *aXi += rx * div_1_rr;
+        *aYi += ry * div_1_rr;
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void accumulate_acceleration_avx2(Particles *particles, int i_start, int i_end, int j_start, int j_end, double epsilon)
+{
+    const __m256d eps = _mm256_set1_pd(epsilon);
+
+    for (int i = i_start; i < i_end; i++)
+    {
+        const __m256d xi = _mm256_set1_pd(particles->posx[i]);
+        const __m256d yi = _mm256_set1_pd(particles->posy[i]);
+        __m256d ax = _mm256_setzero_pd();
+        __m256d ay = _mm256_setzero_pd();
+
+        int j = j_start;
+        for (; j + 4 <= j_end; j += 4)
+        {
+            __m256d rx = _mm256_sub_pd(xi, _mm256_loadu_pd(particles->posx + j));
+            __m256d ry = _mm256_sub_pd(yi, _mm256_loadu_pd(particles->posy + j));
+            __m256d r = _mm256_sqrt_pd(_mm256_fmadd_pd(rx, rx, _mm256_mul_pd(ry, ry)));
+            __m256d rr = _mm256_add_pd(r, eps);
+            __m256d div_1_rr = _mm256_div_pd(_mm256_loadu_pd(particles->mass + j), _mm256_mul_pd(rr, _mm256_mul_pd(rr, rr)));
+            ax = _mm256_fmadd_pd(rx, div_1_rr, ax);
+            ay = _mm256_fmadd_pd(ry, div_1_rr, ay);
+        }
+
+        // Horizontal sum of the four lanes
+        __m128d sx = _mm_add_pd(_mm256_castpd256_pd128(ax), _mm256_extractf128_pd(ax, 1));
+        __m128d sy = _mm_add_pd(_mm256_castpd256_pd128(ay), _mm256_extractf128_pd(ay, 1));
+        double aXi = _mm_cvtsd_f64(_mm_add_sd(sx, _mm_unpackhi_pd(sx, sx)));
+        double aYi = _mm_cvtsd_f64(_mm_add_sd(sy, _mm_unpackhi_pd(sy, sy)));
+
+        add_remainder(particles, i, j, j_end, epsilon, &aXi, &aYi);
+        particles->accx[i] += aXi;
+        particles->accy[i] += aYi;
+    }
+}
+
+__attribute__((target("avx512f")))
+static void accumulate_acceleration_avx512(Particles *particles, int i_start, int i_end, int j_start, int j_end, double epsilon)
+{
+    const __m512d eps = _mm512_set1_pd(epsilon);
+
+    for (int i = i_start; i < i_end; i++)
+    {
+        const __m512d xi = _mm512_set1_pd(particles->posx[i]);
+        const __m512d yi = _mm512_set1_pd(particles->posy[i]);
+        __m512d ax = _mm512_setzero_pd();
+        __m512d ay = _mm512_setzero_pd();
+
+        int j = j_start;
+        for (; j + 8 <= j_end; j += 8)
+        {
+            __m512d rx = _mm512_sub_pd(xi, _mm512_loadu_pd(particles->posx + j));
+            __m512d ry = _mm512_sub_pd(yi, _mm512_loadu_pd(particles->posy + j));
+            __m512d r = _mm512_sqrt_pd(_mm512_fmadd_pd(rx, rx, _mm512_mul_pd(ry, ry)));
+            __m512d rr = _mm512_add_pd(r, eps);
+            __m512d div_1_rr = _mm512_div_pd(_mm512_loadu_pd(particles->mass + j), _mm512_mul_pd(rr, _mm512_mul_pd(rr, rr)));
+            ax = _mm512_fmadd_pd(rx, div_1_rr, ax);
+            ay = _mm512_fmadd_pd(ry, div_1_rr, ay);
+        }
+
+        double aXi = _mm512_reduce_add_pd(ax);
+        double aYi = _mm512_reduce_add_pd(ay);
+
+        add_remainder(particles, i, j, j_end, epsilon, &aXi, &aYi);
+        particles->accx[i] += aXi;
+        particles->accy[i] += aYi;
+    }
+}
+
+static void update_acceleration_avx2(Particles *particles, int N, double epsilon)
+{
+    clear_acceleration(particles, N);
+    accumulate_acceleration_avx2(particles, 0, N, 0, N, epsilon);
+}
+
+static void update_acceleration_avx512(Particles *particles, int N, double epsilon)
+{
+    clear_acceleration(particles, N);
+    accumulate_acceleration_avx512(particles, 0, N, 0, N, epsilon);
+}
+
+#endif
+
+AccelerationBlockKernel select_acceleration_block_kernel(const char **name)
+{
+    AccelerationBlockKernel kernel = accumulate_acceleration_scalar;
+    const char *kernel_name = "scalar";
+
+#ifdef HAVE_X86_DISPATCH
+    // GALSIM_SIMD=avx2 or =scalar caps the ISA, e.g. to compare kernels on one machine
+    const char *limit = getenv("GALSIM_SIMD");
+    int allow_avx512 = limit == NULL || strcmp(limit, "avx512") == 0;
+    int allow_avx2 = allow_avx512 || strcmp(limit, "avx2") == 0;
+
+    __builtin_cpu_init();
+    if (allow_avx512 && __builtin_cpu_supports("avx512f"))
+    {
+        kernel = accumulate_acceleration_avx512;
+        kernel_name = "avx512";
+    }
+    else if (allow_avx2 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        kernel = accumulate_acceleration_avx2;
+        kernel_name = "avx2";
+    }
+#endif
+
+    if (name != NULL)
+    {
+        *name = kernel_name;
+    }
+    return kernel;
+}
+
+AccelerationKernel select_acceleration_kernel(const char **name)
+{
+    AccelerationBlockKernel block = select_acceleration_block_kernel(name);
+
+#ifdef HAVE_X86_DISPATCH
+    if (block == accumulate_acceleration_avx512)
+    {
+        return update_acceleration_avx512;
+    }
+    if (block == accumulate_acceleration_avx2)
+    {
+        return update_acceleration_avx2;
+    }
+#endif
+    return update_acceleration_scalar;
+}
@@ -0,0 +1,42 @@
+#ifndef _simd_kernel_h
+#define _simd_kernel_h
+
+#include "particles.h"
+
+/*
+ * Fills accx/accy with sum_j m_j * r_ij / (|r_ij| + epsilon)^3 over all j.
+ * The j == i term has r_ij = 0 and contributes nothing, so the kernels do
+ * not need a branch in the inner loop.
+ */
+typedef void (*AccelerationKernel)(Particles *particles, int N, double epsilon);
+
+/*
+ * Adds the contribution of particles j_start..j_end-1 to accx/accy of
+ * particles i_start..i_end-1. Used by the tiled driver.
+ */
+typedef void (*AccelerationBlockKernel)(Particles *particles, int i_start, int i_end, int j_start, int j_end, double epsilon);
+
+/*
+ * Function: select_acceleration_kernel
+ * Usage: AccelerationKernel kernel = select_acceleration_kernel(&name);
+ * ---------------------------------------------------------------------
+ * Picks the widest kernel the running CPU supports: AVX-512 (8 lanes),
+ * AVX2 (4 lanes) or plain C. The choice is made once at startup with
+ * CPUID, so the same binary runs on every x86 node. The environment
+ * variable GALSIM_SIMD (avx512, avx2 or scalar) caps the choice. If name is
+ * not NULL it is set to the name of the chosen kernel.
+ */
+AccelerationKernel select_acceleration_kernel(const char **name);
+
+/*
+ * Function: select_acceleration_block_kernel
+ * Usage: AccelerationBlockKernel block = select_acceleration_block_kernel(&name);
+ * -------------------------------------------------------------------------------
+ * Same dispatch as select_acceleration_kernel, for the block form.
+ */
+AccelerationBlockKernel select_acceleration_block_kernel(const char **name);
+
+void update_acceleration_scalar(Particles *particles, int N, double epsilon);
+void accumulate_acceleration_scalar(Particles *particles, int i_start, int i_end, int j_start, int j_end, double epsilon);
+
+#endif
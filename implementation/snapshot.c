@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "snapshot.h"
+#include "gal_io.h"
+
+static void *writer_main(void *arg)
+{
+    SnapshotWriter *writer = (SnapshotWriter *)arg;
+    int current = 0;
+    size_t name_length = strlen(writer->prefix) + strlen(writer->extension) + 32;
+    char *filename = malloc(name_length);
+
+    pthread_mutex_lock(&writer->lock);
+    while (1)
+    {
+        // Buffers are filled alternately, so they are also written alternately
+        while (!writer->full[current] && !writer->shutdown)
+        {
+            pthread_cond_wait(&writer->changed, &writer->lock);
+        }
+        if (!writer->full[current])
+        {
+            break;
+        }
+        int step = writer->step[current];
+        pthread_mutex_unlock(&writer->lock);
+
+        // The fields left out (accelerations, mapping, arena) are NULL, the writers never read them
+        Particles view = {
+            .posx = writer->staging[current][0],
+            .posy = writer->staging[current][1],
+            .mass = writer->mass,
+            .velx = writer->staging[current][2],
+            .vely = writer->staging[current][3],
+            .brightness = writer->brightness
+        };
+        if (writer->stream != NULL)
+        {
+            gsz_writer_append(writer->stream, &view, step, writer->delta_t);
+        }
+        else
+        {
+            snprintf(filename, name_length, "%s_%06d%s", writer->prefix, step, writer->extension);
+            save_particles(writer->N, &view, filename, step, writer->delta_t);
+        }
+
+        pthread_mutex_lock(&writer->lock);
+        writer->full[current] = 0;
+        pthread_cond_broadcast(&writer->changed);
+        current ^= 1;
+    }
+    pthread_mutex_unlock(&writer->lock);
+
+    free(filename);
+    return NULL;
+}
+
+SnapshotWriter *snapshot_writer_create(const Particles *particles, int N, int every, const char *prefix,
+                                       const char *format, double position_error, double delta_t)
+{
+    if (every <= 0)
+    {
+        return NULL;
+    }
+
+    GszStream *stream = NULL;
+    const char *extension = strcmp(format, "gsnap") == 0 ? ".gsnap" : ".gal";
+    if (strcmp(format, "gsz") == 0)
+    {
+        // All snapshots go into one stream, since each frame is encoded against the one before
+        extension = ".gsz";
+        char *filename = malloc(strlen(prefix) + strlen(extension) + 1);
+        sprintf(filename, "%s%s", prefix, extension);
+        stream = gsz_writer_create(filename, N, position_error);
+        free(filename);
+        if (stream == NULL)
+        {
+            return NULL;
+        }
+    }
+
+    SnapshotWriter *writer = malloc(sizeof(SnapshotWriter));
+    writer->N = N;
+    writer->every = every;
+    writer->prefix = strdup(prefix);
+    writer->extension = strdup(extension);
+    writer->stream = stream;
+    writer->order = NULL;
+    writer->delta_t = delta_t;
+    writer->mass = malloc(N * sizeof(double));
+    writer->brightness = malloc(N * sizeof(double));
+    memcpy(writer->mass, particles->mass, N * sizeof(double));
+    memcpy(writer->brightness, particles->brightness, N * sizeof(double));
+    for (int b = 0; b < 2; b++)
+    {
+        for (int f = 0; f < 4; f++)
+        {
+            writer->staging[b][f] = malloc(N * sizeof(double));
+        }
+        writer->step[b] = 0;
+        writer->full[b] = 0;
+    }
+    writer->next = 0;
+    writer->shutdown = 0;
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->changed, NULL);
+    pthread_create(&writer->thread, NULL, writer_main, writer);
+    return writer;
+}
+
+void snapshot_writer_set_order(SnapshotWriter *writer, const int *order)
+{
+    if (writer != NULL)
+    {
+        writer->order = order;
+    }
+}
+
+int snapshot_writer_due(const SnapshotWriter *writer, int step)
+{
+    return writer != NULL && step % writer->every == 0;
+}
+
+void snapshot_writer_step(SnapshotWriter *writer, const Particles *particles, int step)
+{
+    if (!snapshot_writer_due(writer, step))
+    {
+        return;
+    }
+
+    int b = writer->next;
+    pthread_mutex_lock(&writer->lock);
+    while (writer->full[b])
+    {
+        pthread_cond_wait(&writer->changed, &writer->lock);
+    }
+    pthread_mutex_unlock(&writer->lock);
+
+    // The writer thread does not touch a buffer that is not marked full
+    if (writer->order != NULL)
+    {
+        for (int k = 0; k < writer->N; k++)
+        {
+            int i = writer->order[k];
+            writer->staging[b][0][i] = particles->posx[k];
+            writer->staging[b][1][i] = particles->posy[k];
+            writer->staging[b][2][i] = particles->velx[k];
+            writer->staging[b][3][i] = particles->vely[k];
+        }
+    }
+    else
+    {
+        memcpy(writer->staging[b][0], particles->posx, writer->N * sizeof(double));
+        memcpy(writer->staging[b][1], particles->posy, writer->N * sizeof(double));
+        memcpy(writer->staging[b][2], particles->velx, writer->N * sizeof(double));
+        memcpy(writer->staging[b][3], particles->vely, writer->N * sizeof(double));
+    }
+
+    pthread_mutex_lock(&writer->lock);
+    writer->step[b] = step;
+    writer->full[b] = 1;
+    pthread_cond_broadcast(&writer->changed);
+    pthread_mutex_unlock(&writer->lock);
+    writer->next = b ^ 1;
+}
+
+void snapshot_writer_destroy(SnapshotWriter *writer)
+{
+    if (writer == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&writer->lock);
+    writer->shutdown = 1;
+    pthread_cond_broadcast(&writer->changed);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->changed);
+    for (int b = 0; b < 2; b++)
+    {
+        for (int f = 0; f < 4; f++)
+        {
+            free(writer->staging[b][f]);
+        }
+    }
+    gsz_close(writer->stream);
+    free(writer->mass);
+    free(writer->brightness);
+    free(writer->prefix);
+    free(writer->extension);
+    free(writer);
+}
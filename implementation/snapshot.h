@@ -0,0 +1,91 @@
+#ifndef _snapshot_h
+#define _snapshot_h
+
+#include <pthread.h>
+#include "particles.h"
+#include "gsz.h"
+
+/*
+ * Writes the state every "every" steps on a background thread, either to
+ * <prefix>_<step>.gal / .gsnap or as frames of one compressed stream
+ * <prefix>.gsz. Positions and velocities are copied into one of two
+ * staging buffers, so the step loop only waits if both buffers are still
+ * being written or compressed.
+ */
+typedef struct
+{
+    int N;
+    int every;
+    char *prefix;
+    char *extension;
+    // Open when the format is gsz, the files named by prefix/extension are not used then
+    GszStream *stream;
+    // Original index of each stored particle, NULL while the arrays are in file order
+    const int *order;
+    double delta_t;
+    double *mass;
+    double *brightness;
+    // Staging buffer b holds posx, posy, velx, vely for the step in step[b]
+    double *staging[2][4];
+    int step[2];
+    int full[2];
+    int next;
+    int shutdown;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} SnapshotWriter;
+
+/*
+ * Function: snapshot_writer_create
+ * Usage: snapshots = snapshot_writer_create(particles, N, 100, "snapshot", "gal", 0.0, delta_t);
+ * ----------------------------------------------------------------------------------------------
+ * Starts the writer thread. format is "gal", "gsnap" or "gsz";
+ * position_error is the largest position change the gsz stream may make,
+ * 0 for lossless, and is ignored by the other formats. mass and
+ * brightness are copied once since they never change during a run.
+ * Returns NULL when every <= 0 or the stream cannot be created, and all
+ * other functions accept NULL, so callers need no special case when
+ * snapshots are off.
+ */
+SnapshotWriter *snapshot_writer_create(const Particles *particles, int N, int every, const char *prefix,
+                                       const char *format, double position_error, double delta_t);
+
+/*
+ * Function: snapshot_writer_step
+ * Usage: snapshot_writer_step(snapshots, particles, step + 1);
+ * ------------------------------------------------------------
+ * Call after every completed step. Hands the current state to the writer
+ * thread if step is a multiple of the snapshot interval.
+ */
+void snapshot_writer_step(SnapshotWriter *writer, const Particles *particles, int step);
+
+/*
+ * Function: snapshot_writer_set_order
+ * Usage: snapshot_writer_set_order(snapshots, reorder->order);
+ * ------------------------------------------------------------
+ * Tells the writer that particle k is stored at position k of the arrays
+ * only up to the permutation order, which must stay valid while the
+ * writer is used. Snapshots are written in the original order, matching
+ * mass and brightness, which were copied at creation.
+ */
+void snapshot_writer_set_order(SnapshotWriter *writer, const int *order);
+
+/*
+ * Function: snapshot_writer_due
+ * Usage: if (snapshot_writer_due(snapshots, step + 1)) ...
+ * --------------------------------------------------------
+ * Returns 1 if snapshot_writer_step would write the given step, so an
+ * integrator can bring the state to that step first. Returns 0 for NULL.
+ */
+int snapshot_writer_due(const SnapshotWriter *writer, int step);
+
+/*
+ * Function: snapshot_writer_destroy
+ * Usage: snapshot_writer_destroy(snapshots);
+ * ------------------------------------------
+ * Waits for the pending snapshots to reach the disk and stops the thread.
+ */
+void snapshot_writer_destroy(SnapshotWriter *writer);
+
+#endif
@@ -0,0 +1,20 @@
+#include "tiled_kernel.h"
+
+void update_acceleration_tiled(AccelerationBlockKernel block, Particles *particles, int N, double epsilon)
+{
+    for (int i = 0; i < N; i++)
+    {
+        particles->accx[i] = 0.0;
+        particles->accy[i] = 0.0;
+    }
+
+    for (int ii = 0; ii < N; ii += TILE_I)
+    {
+        int i_end = ii + TILE_I < N ? ii + TILE_I : N;
+        for (int jj = 0; jj < N; jj += TILE_J)
+        {
+            int j_end = jj + TILE_J < N ? jj + TILE_J : N;
+            block(particles, ii, i_end, jj, j_end, epsilon);
+        }
+    }
+}
@@ -0,0 +1,27 @@
+#ifndef _tiled_kernel_h
+#define _tiled_kernel_h
+
+#include "particles.h"
+#include "simd_kernel.h"
+
+/* Tile sizes in particles. The j tile (posx, posy, mass) plus the i tile
+   (posx, posy, accx, accy) should fit in L1; override with -DTILE_I=...
+   -DTILE_J=... to retune for another cache. */
+#ifndef TILE_I
+#define TILE_I 256
+#endif
+#ifndef TILE_J
+#define TILE_J 512
+#endif
+
+/*
+ * Function: update_acceleration_tiled
+ * Usage: update_acceleration_tiled(block, particles, N, epsilon);
+ * ---------------------------------------------------------------
+ * Same result as the direct kernels, but evaluates the N x N interactions
+ * as TILE_I x TILE_J blocks so that every j tile is reused from cache by
+ * a whole i tile instead of being streamed once per particle.
+ */
+void update_acceleration_tiled(AccelerationBlockKernel block, Particles *particles, int N, double epsilon);
+
+#endif
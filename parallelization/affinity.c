@@ -0,0 +1,223 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include "affinity.h"
+
+typedef struct
+{
+    const Affinity *affinity;
+    int thread_id;
+    int status;
+} PinTask;
+
+// Package id from sysfs, 0 when the topology is not exported
+static int cpu_package(int cpu)
+{
+    char path[96];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+    FILE *file = fopen(path, "r");
+    int package = 0;
+    if (file != NULL)
+    {
+        if (fscanf(file, "%d", &package) != 1 || package < 0)
+        {
+            package = 0;
+        }
+        fclose(file);
+    }
+    return package;
+}
+
+// Parses "0,2,8-11" into cpus, returns the count or -1 on a syntax error, an unavailable or a repeated CPU.
+// Every CPU appears at most once, so cpus never holds more than CPU_SETSIZE entries
+static int parse_cpu_list(const char *spec, const cpu_set_t *allowed, int *cpus)
+{
+    int count = 0;
+    cpu_set_t seen;
+    CPU_ZERO(&seen);
+    const char *p = spec;
+    while (*p != '\0')
+    {
+        char *end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+        if (end == p)
+        {
+            return -1;
+        }
+        p = end;
+        if (*p == '-')
+        {
+            p++;
+            last = strtol(p, &end, 10);
+            if (end == p)
+            {
+                return -1;
+            }
+            p = end;
+        }
+        if (first < 0 || last < first || last >= CPU_SETSIZE)
+        {
+            return -1;
+        }
+        for (long cpu = first; cpu <= last; cpu++)
+        {
+            if (!CPU_ISSET(cpu, allowed) || CPU_ISSET(cpu, &seen))
+            {
+                return -1;
+            }
+            CPU_SET(cpu, &seen);
+            cpus[count++] = (int)cpu;
+        }
+        if (*p == ',')
+        {
+            p++;
+        }
+        else if (*p != '\0')
+        {
+            return -1;
+        }
+    }
+    return count;
+}
+
+Affinity *affinity_create(const char *spec, int thread_count)
+{
+    cpu_set_t allowed;
+    if (thread_count < 1 || sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    {
+        return NULL;
+    }
+
+    // Available CPUs with their package, in CPU number order
+    int *cpus = malloc(CPU_SETSIZE * sizeof(int));
+    int *packages = malloc(CPU_SETSIZE * sizeof(int));
+    int count = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if (CPU_ISSET(cpu, &allowed))
+        {
+            cpus[count] = cpu;
+            packages[count] = cpu_package(cpu);
+            count++;
+        }
+    }
+
+    int *order = malloc(CPU_SETSIZE * sizeof(int));
+    int order_count = 0;
+    if (strcmp(spec, "compact") == 0 || strcmp(spec, "scatter") == 0)
+    {
+        // Group by package; compact takes the groups one after another, scatter one CPU of each in turn
+        int max_package = 0;
+        for (int k = 0; k < count; k++)
+        {
+            max_package = packages[k] > max_package ? packages[k] : max_package;
+        }
+        int scatter = strcmp(spec, "scatter") == 0;
+        int *taken = calloc(count, sizeof(int));
+        while (order_count < count)
+        {
+            for (int package = 0; package <= max_package; package++)
+            {
+                for (int k = 0; k < count; k++)
+                {
+                    if (!taken[k] && packages[k] == package)
+                    {
+                        taken[k] = 1;
+                        order[order_count++] = cpus[k];
+                        if (scatter)
+                        {
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+        free(taken);
+    }
+    else
+    {
+        order_count = parse_cpu_list(spec, &allowed, order);
+    }
+    free(cpus);
+    free(packages);
+
+    if (order_count <= 0)
+    {
+        free(order);
+        return NULL;
+    }
+
+    Affinity *affinity = malloc(sizeof(Affinity));
+    affinity->thread_count = thread_count;
+    affinity->cpu = malloc(thread_count * sizeof(int));
+    affinity->socket = malloc(thread_count * sizeof(int));
+    affinity->socket_rank = malloc(thread_count * sizeof(int));
+    affinity->socket_size = calloc(thread_count, sizeof(int));
+    affinity->socket_count = 0;
+
+    int socket_package[thread_count];
+    for (int t = 0; t < thread_count; t++)
+    {
+        affinity->cpu[t] = order[t % order_count];
+        int package = cpu_package(affinity->cpu[t]);
+        int s = 0;
+        while (s < affinity->socket_count && socket_package[s] != package)
+        {
+            s++;
+        }
+        if (s == affinity->socket_count)
+        {
+            socket_package[affinity->socket_count++] = package;
+        }
+        affinity->socket[t] = s;
+        affinity->socket_rank[t] = affinity->socket_size[s]++;
+    }
+    free(order);
+    return affinity;
+}
+
+static void *pin_thread(void *arg)
+{
+    PinTask *task = (PinTask *)arg;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(task->affinity->cpu[task->thread_id], &set);
+    task->status = pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0 ? 0 : -1;
+    return NULL;
+}
+
+int affinity_pin(const Affinity *affinity, ThreadPool *pool)
+{
+    PinTask tasks[pool->thread_count];
+    for (int t = 0; t < pool->thread_count; t++)
+    {
+        tasks[t].affinity = affinity;
+        tasks[t].thread_id = t;
+        tasks[t].status = 0;
+    }
+    pool_run(pool, pin_thread, tasks, sizeof(PinTask));
+
+    int status = 0;
+    for (int t = 0; t < pool->thread_count; t++)
+    {
+        status |= tasks[t].status;
+    }
+    return status;
+}
+
+void affinity_destroy(Affinity *affinity)
+{
+    if (affinity == NULL)
+    {
+        return;
+    }
+    free(affinity->cpu);
+    free(affinity->socket);
+    free(affinity->socket_rank);
+    free(affinity->socket_size);
+    free(affinity);
+}
@@ -0,0 +1,47 @@
+#ifndef _affinity_h
+#define _affinity_h
+
+#include "thread_pool.h"
+
+/*
+ * CPU placement of the pool threads. Thread i runs on cpu[i], which lies
+ * on socket[i] (a dense index below socket_count, numbered in the order
+ * the sockets first appear). socket_rank[i] is the position of thread i
+ * among the socket_size[socket[i]] threads that share its socket.
+ */
+typedef struct
+{
+    int thread_count;
+    int *cpu;
+    int *socket;
+    int *socket_rank;
+    int socket_count;
+    int *socket_size;
+} Affinity;
+
+/*
+ * Function: affinity_create
+ * Usage: Affinity *affinity = affinity_create("scatter", thread_count);
+ * ---------------------------------------------------------------------
+ * Chooses a CPU for every thread among the CPUs the process may run on.
+ * "compact" fills one socket before moving to the next, "scatter" deals
+ * the threads round-robin over the sockets, and a list such as "0,2,8-11"
+ * names the CPUs explicitly. Threads wrap around when there are more of
+ * them than CPUs. Returns NULL if the spec cannot be parsed, names a CPU
+ * that is not available or names a CPU twice.
+ */
+Affinity *affinity_create(const char *spec, int thread_count);
+
+/*
+ * Function: affinity_pin
+ * Usage: affinity_pin(affinity, pool);
+ * ------------------------------------
+ * Binds pool thread i (thread 0 is the caller) to affinity->cpu[i]. Pages
+ * the threads touch afterwards are then placed on their own socket.
+ * Returns 0 on success and -1 if any thread could not be bound.
+ */
+int affinity_pin(const Affinity *affinity, ThreadPool *pool);
+
+void affinity_destroy(Affinity *affinity);
+
+#endif
@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "distributed.h"
+#include "transport.h"
+#include "thread_pool.h"
+
+typedef struct
+{
+    Particles *particles;
+    // Rows of this thread and the first row of the rank, which indexes dvx/dvy
+    int start_n;
+    int end_n;
+    int rank_start;
+    // Velocity changes of the rank's rows, summed over all j-blocks of a step
+    double *dvx;
+    double *dvy;
+    // The j-block the current phase works on
+    const double *block_posx;
+    const double *block_posy;
+    int block_start;
+    int block_end;
+    double epsilon;
+    double dtG;
+    double delta_t;
+} RankInput;
+
+static void *block_forces(void *arg)
+{
+    RankInput *input = (RankInput *)arg;
+    const double *posx = input->block_posx;
+    const double *posy = input->block_posy;
+    const double *mass = input->particles->mass;
+
+    for (int i = input->start_n; i < input->end_n; i++)
+    {
+        double xi = input->particles->posx[i];
+        double yi = input->particles->posy[i];
+        double sum_x = 0.0, sum_y = 0.0;
+        for (int j = input->block_start; j < input->block_end; j++)
+        {
+            if (j == i)
+            {
+                continue;
+            }
+            double rx = xi - posx[j];
+            double ry = yi - posy[j];
+            double rr = sqrt(rx * rx + ry * ry) + input->epsilon;
+            double div_1_rr = input->dtG / (rr * rr * rr);
+            sum_x += mass[j] * rx * div_1_rr;
+            sum_y += mass[j] * ry * div_1_rr;
+        }
+        input->dvx[i - input->rank_start] += sum_x;
+        input->dvy[i - input->rank_start] += sum_y;
+    }
+    return NULL;
+}
+
+static void *advance_rows(void *arg)
+{
+    RankInput *input = (RankInput *)arg;
+    Particles *particles = input->particles;
+    for (int i = input->start_n; i < input->end_n; i++)
+    {
+        particles->velx[i] += input->dvx[i - input->rank_start];
+        particles->vely[i] += input->dvy[i - input->rank_start];
+        input->dvx[i - input->rank_start] = 0.0;
+        input->dvy[i - input->rank_start] = 0.0;
+        particles->posx[i] += particles->velx[i] * input->delta_t;
+        particles->posy[i] += particles->vely[i] * input->delta_t;
+    }
+    return NULL;
+}
+
+static void run_rank(Transport *transport, Particles *particles, int first_step, int nsteps, double delta_t,
+                     double epsilon, double dtG, int thread_count)
+{
+    const int rank = transport->rank;
+    const int lo = transport->bounds[rank];
+    const int count = transport->bounds[rank + 1] - lo;
+    double *dvx = calloc(count > 0 ? count : 1, sizeof(double));
+    double *dvy = calloc(count > 0 ? count : 1, sizeof(double));
+
+    ThreadPool *pool = pool_create(thread_count);
+    RankInput input[thread_count];
+    for (int t = 0; t < thread_count; t++)
+    {
+        RankInput temp_input = {
+            particles,
+            lo + (int)((long)count * t / thread_count),
+            lo + (int)((long)count * (t + 1) / thread_count),
+            lo,
+            dvx,
+            dvy,
+            NULL,
+            NULL,
+            0,
+            0,
+            epsilon,
+            dtG,
+            delta_t
+        };
+        input[t] = temp_input;
+    }
+
+    for (int step = first_step; step < nsteps; step++)
+    {
+        // Systolic order: rank r starts with its own block, then r + 1, r + 2, ... modulo the ring
+        for (int k = 0; k < transport->size; k++)
+        {
+            int src = (rank + k) % transport->size;
+            const double *block_posx, *block_posy;
+            transport->fetch(transport, step, src, &block_posx, &block_posy);
+            for (int t = 0; t < thread_count; t++)
+            {
+                input[t].block_posx = block_posx;
+                input[t].block_posy = block_posy;
+                input[t].block_start = transport->bounds[src];
+                input[t].block_end = transport->bounds[src + 1];
+            }
+            pool_run(pool, block_forces, input, sizeof(RankInput));
+        }
+        pool_run(pool, advance_rows, input, sizeof(RankInput));
+        transport->publish(transport, step + 1, particles->posx, particles->posy);
+    }
+
+    pool_destroy(pool);
+    free(dvx);
+    free(dvy);
+
+    double *fields[4] = {particles->posx, particles->posy, particles->velx, particles->vely};
+    transport->gather(transport, fields, 4);
+}
+
+int run_distributed(Particles *particles, int N, int first_step, int nsteps, double delta_t, double epsilon,
+                    double dtG, int ranks, int thread_count)
+{
+    int bounds[ranks + 1];
+    for (int r = 0; r <= ranks; r++)
+    {
+        bounds[r] = (int)((long)N * r / ranks);
+    }
+
+    Transport *transport = transport_shm_create(ranks, N, bounds, first_step, particles->posx, particles->posy);
+    if (transport == NULL)
+    {
+        return -1;
+    }
+
+    // Unflushed output would otherwise be printed once per process
+    fflush(stdout);
+    pid_t pids[ranks];
+    for (int r = 1; r < ranks; r++)
+    {
+        pids[r] = fork();
+        if (pids[r] == 0)
+        {
+            transport->rank = r;
+            run_rank(transport, particles, first_step, nsteps, delta_t, epsilon, dtG, thread_count);
+            _exit(0);
+        }
+        if (pids[r] < 0)
+        {
+            // The ranks already started would wait forever for the missing block
+            for (int k = 1; k < r; k++)
+            {
+                kill(pids[k], SIGKILL);
+                waitpid(pids[k], NULL, 0);
+            }
+            transport->close(transport);
+            return -1;
+        }
+    }
+
+    run_rank(transport, particles, first_step, nsteps, delta_t, epsilon, dtG, thread_count);
+
+    int status = 0;
+    for (int r = 1; r < ranks; r++)
+    {
+        int rank_status;
+        if (waitpid(pids[r], &rank_status, 0) != pids[r] || !WIFEXITED(rank_status) || WEXITSTATUS(rank_status) != 0)
+        {
+            status = -1;
+        }
+    }
+    transport->close(transport);
+    return status;
+}
@@ -0,0 +1,22 @@
+#ifndef _distributed_h
+#define _distributed_h
+
+#include "particles.h"
+
+/*
+ * Function: run_distributed
+ * Usage: status = run_distributed(particles, N, first_step, nsteps, delta_t, epsilon, dtG, ranks, threads);
+ * ---------------------------------------------------------------------------------------------------------
+ * Advances the particles from first_step to nsteps with ranks processes.
+ * The caller is rank 0 and forks the others; rank k owns an equal block
+ * of the particles and splits its rows over threads pool threads, the way
+ * ThreadInput splits them inside one process. Each step a rank walks the
+ * position blocks of all ranks in ring order, starting with its own, so
+ * it computes while the blocks of slower ranks are still arriving. On
+ * return the caller's particles hold the final positions and velocities.
+ * Returns 0 on success and -1 if the transport or a rank failed.
+ */
+int run_distributed(Particles *particles, int N, int first_step, int nsteps, double delta_t, double epsilon,
+                    double dtG, int ranks, int thread_count);
+
+#endif
@@ -0,0 +1,383 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include "particles.h"
+#include "gal_io.h"
+#include "galsnap.h"
+#include "options.h"
+#include "simd_kernel.h"
+#include "thread_pool.h"
+
+#define MAX_PATH 1024
+#define DEFAULT_SPLIT_N 4096
+
+/*
+ * Runs many independent simulations in one process. Every line of the
+ * manifest is a job "input nsteps delta_t [output]"; blank lines and lines
+ * starting with '#' are skipped. The result of a job goes to output, or
+ * to <output-dir>/<input name>_after<nsteps>steps.gal like the files in
+ * ref_output_data. Jobs with at least --split-n particles run one after
+ * another with their rows split over all threads; the smaller ones are
+ * packed one per thread, largest first, and each thread takes the next
+ * job as soon as it is done.
+ */
+
+typedef struct
+{
+    char input[MAX_PATH];
+    char output[MAX_PATH];
+    int nsteps;
+    double delta_t;
+    int N;
+    // Filled in when the job has run
+    double seconds;
+    int status;
+} Job;
+
+typedef struct
+{
+    Job *jobs;
+    // Indices of the packed jobs, largest first; next is the first one not taken yet
+    int *queue;
+    int queue_length;
+    int next;
+    pthread_mutex_t lock;
+} JobQueue;
+
+typedef struct
+{
+    JobQueue *queue;
+    int thread_id;
+} PackedInput;
+
+typedef struct
+{
+    Particles *particles;
+    int N;
+    int start_n;
+    int end_n;
+    double epsilon;
+    double dtG;
+    double delta_t;
+} SplitInput;
+
+static const double epsilon = 0.001;
+static AccelerationKernel kernel;
+static AccelerationBlockKernel block_kernel;
+
+double get_wall_seconds()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + (double)tv.tv_usec / 1000000;
+}
+
+// The particle count comes from the snapshot header or from the size of a .gal file
+static int job_particle_count(const char *filename)
+{
+    if (galsnap_is_snapshot(filename))
+    {
+        // Only the header is read here, galsnap_load checks the rest when the job runs
+        GalsnapHeader header;
+        FILE *file = fopen(filename, "rb");
+        if (file == NULL)
+        {
+            return -1;
+        }
+        size_t read = fread(&header, sizeof(GalsnapHeader), 1, file);
+        fclose(file);
+        if (read != 1 || header.N > INT_MAX)
+        {
+            return -1;
+        }
+        return (int)header.N;
+    }
+    struct stat st;
+    if (stat(filename, &st) != 0 || st.st_size % (6 * sizeof(double)) != 0)
+    {
+        return -1;
+    }
+    return (int)(st.st_size / (6 * sizeof(double)));
+}
+
+static void default_output(Job *job, const char *output_dir)
+{
+    const char *name = strrchr(job->input, '/');
+    name = name != NULL ? name + 1 : job->input;
+    const char *dot = strrchr(name, '.');
+    int length = dot != NULL ? (int)(dot - name) : (int)strlen(name);
+    snprintf(job->output, MAX_PATH, "%s/%.*s_after%dsteps.gal", output_dir, length, name, job->nsteps);
+}
+
+// Returns the number of jobs read into *jobs, or -1 if the manifest cannot be read or has a bad line
+static int read_manifest(const char *filename, const char *output_dir, Job **jobs)
+{
+    FILE *file = fopen(filename, "r");
+    if (file == NULL)
+    {
+        printf("Failed to open the manifest '%s'.\n", filename);
+        return -1;
+    }
+
+    int count = 0, capacity = 16;
+    *jobs = malloc(capacity * sizeof(Job));
+    char line[3 * MAX_PATH];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        line_number++;
+        char *start = line + strspn(line, " \t");
+        if (*start == '#' || *start == '\n' || *start == '\0')
+        {
+            continue;
+        }
+        if (count == capacity)
+        {
+            capacity *= 2;
+            *jobs = realloc(*jobs, capacity * sizeof(Job));
+        }
+        Job *job = &(*jobs)[count];
+        job->output[0] = '\0';
+        int fields = sscanf(start, "%1023s %d %lf %1023s", job->input, &job->nsteps, &job->delta_t, job->output);
+        if (fields < 3 || job->nsteps < 0)
+        {
+            printf("%s:%d: expected \"input nsteps delta_t [output]\".\n", filename, line_number);
+            fclose(file);
+            return -1;
+        }
+        if (fields == 3)
+        {
+            default_output(job, output_dir);
+        }
+        job->N = job_particle_count(job->input);
+        job->seconds = 0.0;
+        job->status = -1;
+        count++;
+    }
+    fclose(file);
+    return count;
+}
+
+// One job on the calling thread with the widest SIMD kernel, the same steps as galsim --kernel simd
+static void run_packed_job(Job *job)
+{
+    double start = get_wall_seconds();
+    const int N = job->N;
+    Particles *particles = N >= 0 ? read_particles(N, job->input) : NULL;
+    if (particles == NULL)
+    {
+        return;
+    }
+
+    const double dtG = job->delta_t * (-100.0 / N);
+    for (int step = 0; step < job->nsteps; step++)
+    {
+        kernel(particles, N, epsilon);
+        for (int i = 0; i < N; i++)
+        {
+            particles->velx[i] += dtG * particles->accx[i];
+            particles->vely[i] += dtG * particles->accy[i];
+            particles->posx[i] += particles->velx[i] * job->delta_t;
+            particles->posy[i] += particles->vely[i] * job->delta_t;
+        }
+    }
+
+    job->status = save_particles(N, particles, job->output, job->nsteps, job->delta_t);
+    free_particles(particles);
+    job->seconds = get_wall_seconds() - start;
+}
+
+static void *packed_worker(void *arg)
+{
+    PackedInput *input = (PackedInput *)arg;
+    JobQueue *queue = input->queue;
+    while (1)
+    {
+        pthread_mutex_lock(&queue->lock);
+        int k = queue->next < queue->queue_length ? queue->queue[queue->next++] : -1;
+        pthread_mutex_unlock(&queue->lock);
+        if (k < 0)
+        {
+            return NULL;
+        }
+        run_packed_job(&queue->jobs[k]);
+    }
+}
+
+static void *split_accelerations(void *arg)
+{
+    SplitInput *input = (SplitInput *)arg;
+    Particles *particles = input->particles;
+    for (int i = input->start_n; i < input->end_n; i++)
+    {
+        particles->accx[i] = 0.0;
+        particles->accy[i] = 0.0;
+    }
+    // Whole rows against all particles, so the sums are the same as in the single-threaded kernel
+    block_kernel(particles, input->start_n, input->end_n, 0, input->N, input->epsilon);
+    return NULL;
+}
+
+static void *split_update(void *arg)
+{
+    SplitInput *input = (SplitInput *)arg;
+    Particles *particles = input->particles;
+    for (int i = input->start_n; i < input->end_n; i++)
+    {
+        particles->velx[i] += input->dtG * particles->accx[i];
+        particles->vely[i] += input->dtG * particles->accy[i];
+        particles->posx[i] += particles->velx[i] * input->delta_t;
+        particles->posy[i] += particles->vely[i] * input->delta_t;
+    }
+    return NULL;
+}
+
+// One large job with its rows split over every thread of the pool
+static void run_split_job(ThreadPool *pool, Job *job)
+{
+    double start = get_wall_seconds();
+    const int N = job->N;
+    Particles *particles = N >= 0 ? read_particles(N, job->input) : NULL;
+    if (particles == NULL)
+    {
+        return;
+    }
+
+    const int thread_count = pool->thread_count;
+    SplitInput input[thread_count];
+    for (int t = 0; t < thread_count; t++)
+    {
+        SplitInput temp_input = {
+            particles,
+            N,
+            (int)((long)N * t / thread_count),
+            (int)((long)N * (t + 1) / thread_count),
+            epsilon,
+            job->delta_t * (-100.0 / N),
+            job->delta_t
+        };
+        input[t] = temp_input;
+    }
+
+    for (int step = 0; step < job->nsteps; step++)
+    {
+        pool_run(pool, split_accelerations, input, sizeof(SplitInput));
+        pool_run(pool, split_update, input, sizeof(SplitInput));
+    }
+
+    job->status = save_particles(N, particles, job->output, job->nsteps, job->delta_t);
+    free_particles(particles);
+    job->seconds = get_wall_seconds() - start;
+}
+
+// Work of a job in pair interactions, used to order the packed jobs
+static double job_cost(const Job *job)
+{
+    return (double)job->N * job->N * job->nsteps;
+}
+
+static int compare_cost(const void *a, const void *b, void *jobs)
+{
+    double cost_a = job_cost(&((Job *)jobs)[*(const int *)a]);
+    double cost_b = job_cost(&((Job *)jobs)[*(const int *)b]);
+    return cost_a < cost_b ? 1 : (cost_a > cost_b ? -1 : 0);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *output_dir = ".";
+    argc = extract_option(argc, argv, "--output-dir", &output_dir);
+    const char *split_option = NULL;
+    argc = extract_option(argc, argv, "--split-n", &split_option);
+
+    if (argc != 3)
+    {
+        printf("Usage: %s manifest n_threads [--output-dir dir] [--split-n N]\n", argv[0]);
+        printf("Each manifest line is \"input nsteps delta_t [output]\".\n");
+        return 0;
+    }
+    const int thread_count = atoi(argv[2]);
+    const int split_n = split_option != NULL ? atoi(split_option) : DEFAULT_SPLIT_N;
+    if (thread_count < 1)
+    {
+        printf("n_threads must be at least 1.\n");
+        return 0;
+    }
+
+    Job *jobs = NULL;
+    int job_count = read_manifest(argv[1], output_dir, &jobs);
+    if (job_count < 0)
+    {
+        free(jobs);
+        return 1;
+    }
+
+    const char *kernel_name;
+    kernel = select_acceleration_kernel(&kernel_name);
+    block_kernel = select_acceleration_block_kernel(NULL);
+
+    double startTime = get_wall_seconds();
+    ThreadPool *pool = pool_create(thread_count);
+
+    JobQueue queue;
+    queue.jobs = jobs;
+    queue.queue = malloc((job_count > 0 ? job_count : 1) * sizeof(int));
+    queue.queue_length = 0;
+    queue.next = 0;
+    pthread_mutex_init(&queue.lock, NULL);
+
+    int split_count = 0;
+    for (int k = 0; k < job_count; k++)
+    {
+        if (jobs[k].N >= split_n && thread_count > 1)
+        {
+            run_split_job(pool, &jobs[k]);
+            split_count++;
+        }
+        else
+        {
+            queue.queue[queue.queue_length++] = k;
+        }
+    }
+
+    // Largest first, so the last jobs to start are short and the threads finish close together
+    qsort_r(queue.queue, queue.queue_length, sizeof(int), compare_cost, jobs);
+    PackedInput packed_input[thread_count];
+    for (int t = 0; t < thread_count; t++)
+    {
+        packed_input[t].queue = &queue;
+        packed_input[t].thread_id = t;
+    }
+    pool_run(pool, packed_worker, packed_input, sizeof(PackedInput));
+
+    pool_destroy(pool);
+    pthread_mutex_destroy(&queue.lock);
+    free(queue.queue);
+    double totalTime = get_wall_seconds() - startTime;
+
+    int failed = 0;
+    double interactions = 0.0;
+    for (int k = 0; k < job_count; k++)
+    {
+        if (jobs[k].status != 0)
+        {
+            printf("Job %d (%s) failed.\n", k + 1, jobs[k].input);
+            failed++;
+            continue;
+        }
+        printf("Job %d: %s, N = %d, %d steps in %lf seconds -> %s\n", k + 1, jobs[k].input, jobs[k].N,
+               jobs[k].nsteps, jobs[k].seconds, jobs[k].output);
+        interactions += job_cost(&jobs[k]);
+    }
+    printf("Ran %d jobs (%d split, %d packed, %d failed) on %d threads with the %s kernel in %lf seconds, "
+           "%.3g interactions per second.\n",
+           job_count, split_count, job_count - split_count, failed, thread_count, kernel_name, totalTime,
+           totalTime > 0.0 ? interactions / totalTime : 0.0);
+
+    free(jobs);
+    return failed > 0 ? 1 : 0;
+}
@@ -4,20 +4,20 @@
 #include <math.h>
 #include <sys/time.h>
 #include <pthread.h>
-
-#define VERSION 2
-
-typedef struct
-{
-    double *posx;
-    double *posy;
-    double *mass;
-    double *velx;
-    double *vely;
-    double *accx;
-    double *accy;
-    double *brightness;
-} Particles;
+#include "particles.h"
+#include "gal_io.h"
+#include "options.h"
+#include "snapshot.h"
+#include "checkpoint.h"
+#include "thread_pool.h"
+#include "arena.h"
+#include "affinity.h"
+#include "distributed.h"
+#include "simd_kernel.h"
+
+// --kernel auto times each acceleration phase this many times at most, or until the time is used up
+#define CALIBRATION_CALLS 5
+#define CALIBRATION_SECONDS 0.05
 
 typedef struct
 {
@@ -28,35 +28,126 @@ typedef struct
     double dtG;
     double delta_t;
     Particles *particles;
+    int thread_id;
+    int thread_count;
+    // thread_count rows of N velocity changes, row thread_id is written by this thread only
+    double *scratch_velx;
+    double *scratch_vely;
+    // Arrays the force loop reads, the copies on this thread's socket when there are replicas
+    const double *force_posx;
+    const double *force_posy;
+    const double *force_mass;
+    // Per-socket position copies that the position phase keeps current
+    int replica_count;
+    double **replica_posx;
+    double **replica_posy;
+    // Row kernel of the simd force loop
+    AccelerationBlockKernel block;
 } ThreadInput;
 
-Particles *read_data_v1(int particle_count, char *filename);
-void save_file_v1(int particle_count, Particles *particles);
+/* A force loop this binary can run, chosen with --kernel. Every step runs
+   the three phases on the pool in order. */
+typedef struct
+{
+    const char *name;
+    void *(*acceleration)(void *);
+    void *(*velocity)(void *);
+    void *(*position)(void *);
+    // Rows are split by pair count for the j = i + 1 loop instead of in equal slices
+    int pair_bounds;
+    // The acceleration phase accumulates into the per-thread scratch rows
+    int scratch;
+} ThreadedKernel;
+
+// Moves one thread's share of the particles and scratch rows into memory first touched by that thread
+typedef struct
+{
+    const Particles *source;
+    Particles *target;
+    int N;
+    int thread_id;
+    int thread_count;
+    double *scratch_velx;
+    double *scratch_vely;
+    // posx, posy and mass copies on this thread's socket, NULL without replicas
+    double *replica[3];
+    int socket_rank;
+    int socket_size;
+} PlaceInput;
+
 void print_data(int N, Particles *particles);
 double get_wall_seconds();
+void partition_pairs(int N, int thread_count, int *bounds);
+void *place_particles(void *arg);
+void refresh_replicas(ThreadInput *thread_input, int lo, int hi);
+
+void set_kernel_bounds(ThreadInput *thread_input, int thread_count, int N, const ThreadedKernel *kernel);
+int calibrate_kernels(ThreadPool *pool, ThreadInput *thread_input, int thread_count, int N, double *seconds);
 
-#if VERSION == 1
 void *update_acceleration_v1(void *arg);
 void *update_velocity_v1(void *arg);
 void *update_position_v1(void *arg);
-#elif VERSION == 2
 void *update_acceleration_v2(void *arg);
-void *update_velocity_v2(void *arg);
+void *reduce_velocity_v2(void *arg);
 void *update_position_v2(void *arg);
+void *update_acceleration_simd(void *arg);
 
-// Create a mutex variable
-pthread_mutex_t mutex;
-
-#endif
+// direct: every thread sums over all j for its rows; symmetric: each pair once with per-thread scratch rows;
+// simd: the rows of direct with the widest SIMD kernel the CPU supports
+static const ThreadedKernel kernels[] = {
+    {"direct", update_acceleration_v1, update_velocity_v1, update_position_v1, 0, 0},
+    {"symmetric", update_acceleration_v2, reduce_velocity_v2, update_position_v2, 1, 1},
+    {"simd", update_acceleration_simd, update_velocity_v1, update_position_v1, 0, 0},
+};
+#define KERNEL_COUNT (int)(sizeof(kernels) / sizeof(kernels[0]))
 
 int main(int argc, char *argv[])
 {
+    // Optional flags are taken out first so the positional arguments keep their indices
+    const char *output_file = "result.gal";
+    argc = extract_option(argc, argv, "--output", &output_file);
+    const char *snapshot_every = "0";
+    const char *snapshot_prefix = "snapshot";
+    argc = extract_option(argc, argv, "--snapshot-every", &snapshot_every);
+    argc = extract_option(argc, argv, "--snapshot-prefix", &snapshot_prefix);
+    const char *snapshot_format = "gal";
+    argc = extract_option(argc, argv, "--snapshot-format", &snapshot_format);
+    const char *snapshot_error = "0";
+    argc = extract_option(argc, argv, "--snapshot-error", &snapshot_error);
+    const char *checkpoint_file = "checkpoint.bin";
+    const char *checkpoint_every = "0";
+    const char *checkpoint_interval = "0";
+    int restart;
+    argc = extract_option(argc, argv, "--checkpoint", &checkpoint_file);
+    argc = extract_option(argc, argv, "--checkpoint-every", &checkpoint_every);
+    argc = extract_option(argc, argv, "--checkpoint-interval", &checkpoint_interval);
+    argc = extract_flag(argc, argv, "--restart", &restart);
+    int huge_pages;
+    argc = extract_flag(argc, argv, "--huge-pages", &huge_pages);
+    const char *affinity_spec = "none";
+    argc = extract_option(argc, argv, "--affinity", &affinity_spec);
+    const char *ranks_option = "1";
+    argc = extract_option(argc, argv, "--ranks", &ranks_option);
+    const char *kernel_option = NULL;
+    argc = extract_option(argc, argv, "--kernel", &kernel_option);
 
     // Combine all validation (including type checks) into one method validateInput()
     if (argc != 7)
     {
         printf("Incorrect number of arguments!\n");
-        printf("Usage: %s N filename nsteps delta_t graphics\n", argv[0]);
+        printf("Usage: %s N filename nsteps delta_t graphics n_threads [--output file]\n"
+               "       [--snapshot-every K] [--snapshot-prefix prefix] [--snapshot-format gal|gsnap|gsz]\n"
+               "       [--snapshot-error E]\n"
+               "       [--checkpoint file] [--checkpoint-every K] [--checkpoint-interval seconds] [--restart]\n"
+               "       [--huge-pages] [--affinity none|compact|scatter|cpu-list] [--ranks R]\n"
+               "       [--kernel direct|symmetric|simd|auto]\n", argv[0]);
+        return 0;
+    }
+
+    if (strcmp(snapshot_format, "gal") != 0 && strcmp(snapshot_format, "gsnap") != 0 &&
+        strcmp(snapshot_format, "gsz") != 0)
+    {
+        printf("Unknown snapshot format %s, use gal, gsnap or gsz.\n", snapshot_format);
         return 0;
     }
 
@@ -73,11 +164,86 @@ int main(int argc, char *argv[])
 
     if (graphics == 1)
     {
-        printf("Graphics implementation is not done. You will see the simulation results in result.gal file.\n");
+        printf("Graphics implementation is not done. You will see the simulation results in %s file.\n", output_file);
     }
 
+    // With more than one rank each of them is a process running thread_count threads
+    const int ranks = atoi(ranks_option);
+    if (ranks < 1 || thread_count < 1)
+    {
+        printf("--ranks and n_threads must be at least 1.\n");
+        return 0;
+    }
+    if (ranks > 1 && (atoi(snapshot_every) > 0 || atoi(checkpoint_every) > 0 || atof(checkpoint_interval) > 0 ||
+                      strcmp(affinity_spec, "none") != 0 || kernel_option != NULL))
+    {
+        printf("--ranks cannot be combined with snapshots, checkpoints, --affinity or --kernel.\n");
+        return 0;
+    }
+
+    // --kernel auto times every kernel on the loaded particles before the first step
+    if (kernel_option == NULL)
+    {
+        kernel_option = "symmetric";
+    }
+    const int auto_kernel = strcmp(kernel_option, "auto") == 0;
+    int kernel_index = -1;
+    for (int k = 0; k < KERNEL_COUNT; k++)
+    {
+        if (auto_kernel || strcmp(kernel_option, kernels[k].name) == 0)
+        {
+            kernel_index = k;
+            break;
+        }
+    }
+    if (kernel_index < 0)
+    {
+        printf("Unknown --kernel %s, use direct, symmetric, simd or auto.\n", kernel_option);
+        return 0;
+    }
+
+    Affinity *affinity = NULL;
+    if (strcmp(affinity_spec, "none") != 0)
+    {
+        affinity = affinity_create(affinity_spec, thread_count);
+        if (affinity == NULL)
+        {
+            printf("Unknown --affinity %s, use none, compact, scatter or a list of distinct available CPUs such as 0,2,4-7.\n",
+                   affinity_spec);
+            return 0;
+        }
+    }
+
+    const size_t scratch_bytes =
+        auto_kernel || kernels[kernel_index].scratch ? (size_t)thread_count * N * sizeof(double) : 0;
+    // The per-thread velocity rows share the particles' arena, so the run makes no further allocations
+    set_particle_arena(2 * arena_bytes(scratch_bytes), huge_pages);
+
     /* Read files. */
-    Particles *particles = read_data_v1(N, filename);
+    Particles *particles;
+    int first_step = 0;
+
+    if (restart)
+    {
+        // Continue from the last checkpoint instead of the input file
+        CheckpointHeader header;
+        particles = checkpoint_load(checkpoint_file, &header);
+        if (particles != NULL && (header.N != N || header.delta_t != delta_t || header.G != G || header.epsilon != epsilon))
+        {
+            printf("The checkpoint '%s' was written with N = %d and delta_t = %g.\n", checkpoint_file, header.N, header.delta_t);
+            free_particles(particles);
+            particles = NULL;
+        }
+        if (particles != NULL)
+        {
+            first_step = (int)header.step;
+            printf("Restarting from step %d of %d.\n", first_step, nsteps);
+        }
+    }
+    else
+    {
+        particles = read_particles(N, filename);
+    }
 
     if (particles == NULL)
     {
@@ -85,160 +251,197 @@ int main(int argc, char *argv[])
         return 0;
     }
 
+    CheckpointSchedule checkpoints;
+    checkpoint_schedule_init(&checkpoints, checkpoint_file, atoi(checkpoint_every), atof(checkpoint_interval),
+                             N, delta_t, G, epsilon);
+
     // Variables needed for calcluations
     double aXi, aYi, rx, ry, r, rr, div_1_rr;
     double rx_div, ry_div;
+
     double startTime = get_wall_seconds();
 
-#if VERSION == 1
-    // Start simulation - Parallelized version 1
+    if (ranks > 1)
+    {
+        int status = run_distributed(particles, N, first_step, nsteps, delta_t, epsilon, dtG, ranks, thread_count);
+        double totalTime = get_wall_seconds() - startTime;
+        if (status != 0)
+        {
+            printf("The run over %d ranks failed.\n", ranks);
+            free_particles(particles);
+            return 0;
+        }
+        printf("Time taken for the simulation of %d particals for %d steps on %d ranks x %d threads = %lf seconds.\n",
+               N, nsteps, ranks, thread_count, totalTime);
+        save_particles(N, particles, output_file, nsteps, delta_t);
+        free_particles(particles);
+        return 0;
+    }
 
-    /* Create multiple threads */
-    pthread_t threads[thread_count];
-    /* Create an array of indeces */
-    int thread_index[thread_count];
+    /* Workers live for the whole run, each step only dispatches phases to them */
+    ThreadPool *pool = pool_create(thread_count);
     /* Create an array of ThreadInputs */
     ThreadInput thread_input[thread_count];
 
-    // initialize the thread input array
-    for (int i = 0; i < thread_count; i++)
+    if (affinity != NULL && affinity_pin(affinity, pool) != 0)
     {
-        ThreadInput temp_thread_input = {
-            (N / thread_count) * i,
-            (N / thread_count) * (i + 1),
-            N,
-            epsilon,
-            dtG,
-            delta_t,
-            particles
-        };
-        thread_input[i] = temp_thread_input;
+        printf("Some threads could not be bound to their CPU.\n");
     }
 
-    for (int step = 0; step < nsteps; step++)
+    // Pinned threads first touch the pages they work on: the loaded particles are copied slice by slice into
+    // fresh arrays, so each slice lands on the socket of the thread that updates it
+    Particles *placed = affinity != NULL ? alloc_particles(N) : NULL;
+    Particles *owner = placed != NULL ? placed : particles;
+
+    // Per-thread velocity accumulators live for the whole run, the reduction phase resets them to zero
+    double *scratch_velx = scratch_bytes > 0 ? arena_alloc(owner->arena, scratch_bytes) : NULL;
+    double *scratch_vely = scratch_bytes > 0 ? arena_alloc(owner->arena, scratch_bytes) : NULL;
+
+    // Threads on different sockets read the positions and masses from a copy on their own socket
+    int replica_count = placed != NULL && affinity->socket_count > 1 ? affinity->socket_count : 0;
+    Arena *replica_arena[replica_count > 0 ? replica_count : 1];
+    double *replica_posx[replica_count > 0 ? replica_count : 1];
+    double *replica_posy[replica_count > 0 ? replica_count : 1];
+    double *replica_mass[replica_count > 0 ? replica_count : 1];
+    for (int s = 0; s < replica_count; s++)
     {
-
-	printf("step: %d\n", step);
-        // Start N number of threads for updating acceleration
-        for (int i = 0; i < thread_count; i++)
-        {
-            thread_index[i] = i;
-            pthread_create(&threads[i], NULL, update_acceleration_v1, &thread_input[i]);
-        }
-
-        // Join N number of threads after updating acceleration
-        for (int i = 0; i < thread_count; i++)
+        replica_arena[s] = arena_create(3 * arena_bytes((size_t)N * sizeof(double)), huge_pages);
+        if (replica_arena[s] == NULL)
         {
-            pthread_join(threads[i], NULL);
-        }
-
-        // Start N number of threads for updating velocity
-        for (int i = 0; i < thread_count; i++)
-        {
-            thread_index[i] = i;
-            pthread_create(&threads[i], NULL, update_velocity_v1, &thread_input[i]);
-        }
-
-        // Join N number of threads after updating velocity
-        for (int i = 0; i < thread_count; i++)
-        {
-            pthread_join(threads[i], NULL);
-        }
-
-        // Start N number of threads for updating position
-        for (int i = 0; i < thread_count; i++)
-        {
-            thread_index[i] = i;
-            pthread_create(&threads[i], NULL, update_position_v1, &thread_input[i]);
+            printf("Failed to allocate the per-socket replicas, all sockets share one copy.\n");
+            for (int k = 0; k < s; k++)
+            {
+                arena_destroy(replica_arena[k]);
+            }
+            replica_count = 0;
+            break;
         }
+        replica_posx[s] = arena_alloc(replica_arena[s], (size_t)N * sizeof(double));
+        replica_posy[s] = arena_alloc(replica_arena[s], (size_t)N * sizeof(double));
+        replica_mass[s] = arena_alloc(replica_arena[s], (size_t)N * sizeof(double));
+    }
 
-        // Join N number of threads after updating position
+    if (placed != NULL)
+    {
+        PlaceInput place_input[thread_count];
         for (int i = 0; i < thread_count; i++)
         {
-            pthread_join(threads[i], NULL);
+            int s = affinity->socket[i];
+            PlaceInput temp_place_input = {
+                particles,
+                placed,
+                N,
+                i,
+                thread_count,
+                scratch_velx,
+                scratch_vely,
+                {replica_count > 0 ? replica_posx[s] : NULL, replica_count > 0 ? replica_posy[s] : NULL,
+                 replica_count > 0 ? replica_mass[s] : NULL},
+                affinity->socket_rank[i],
+                affinity->socket_size[s]
+            };
+            place_input[i] = temp_place_input;
         }
+        pool_run(pool, place_particles, place_input, sizeof(PlaceInput));
+        free_particles(particles);
+        particles = placed;
+        printf("Pinned %d threads to CPUs '%s' over %d socket(s), with %d position replica(s).\n",
+               thread_count, affinity_spec, affinity->socket_count, replica_count);
     }
 
-#elif VERSION == 2
-    // Start simulation - Parallelized version 2 with Pthreads
+    // Every K steps the state goes to <prefix>_<step>.gal / .gsnap or into <prefix>.gsz, written in the background
+    SnapshotWriter *snapshots = snapshot_writer_create(particles, N, atoi(snapshot_every), snapshot_prefix,
+                                                       snapshot_format, atof(snapshot_error), delta_t);
 
-    /* Create multiple threads */
-    pthread_t threads[thread_count];
-    /* Create an array of indeces */
-    int thread_index[thread_count];
-    /* Create an array of ThreadInputs */
-    ThreadInput thread_input[thread_count];
-
-    // initialize the thread input array
+    // initialize the thread input array, the row ranges are set for the chosen kernel below
+    AccelerationBlockKernel block = select_acceleration_block_kernel(NULL);
     for (int i = 0; i < thread_count; i++)
     {
         ThreadInput temp_thread_input = {
-            (N / thread_count) * i,
-            (N / thread_count) * (i + 1),
+            0,
+            0,
             N,
             epsilon,
             dtG,
             delta_t,
-            particles
+            particles,
+            i,
+            thread_count,
+            scratch_velx,
+            scratch_vely,
+            replica_count > 0 ? replica_posx[affinity->socket[i]] : particles->posx,
+            replica_count > 0 ? replica_posy[affinity->socket[i]] : particles->posy,
+            replica_count > 0 ? replica_mass[affinity->socket[i]] : particles->mass,
+            replica_count,
+            replica_posx,
+            replica_posy,
+            block
         };
         thread_input[i] = temp_thread_input;
     }
 
-    pthread_mutex_init(&mutex, NULL);
-
-    for (int step = 0; step < nsteps; step++)
+    if (auto_kernel)
     {
-        // Start N number of threads for updating acceleration
-        for (int i = 0; i < thread_count; i++)
+        double seconds[KERNEL_COUNT];
+        kernel_index = calibrate_kernels(pool, thread_input, thread_count, N, seconds);
+        printf("Calibration (ms per acceleration phase on %d threads):", thread_count);
+        for (int k = 0; k < KERNEL_COUNT; k++)
         {
-            thread_index[i] = i;
-            pthread_create(&threads[i], NULL, update_acceleration_v2, &thread_input[i]);
+            printf(" %s %.3f", kernels[k].name, 1000.0 * seconds[k]);
         }
+        printf(", picked %s.\n", kernels[kernel_index].name);
+    }
+    const ThreadedKernel *kernel = &kernels[kernel_index];
+    set_kernel_bounds(thread_input, thread_count, N, kernel);
 
-        // Join N number of threads after updating acceleration
-        for (int i = 0; i < thread_count; i++)
-        {
-            pthread_join(threads[i], NULL);
-        }
+    // Wall time spent in each phase, summed over all steps
+    double accTime = 0.0, velTime = 0.0, posTime = 0.0;
+    double phaseStart;
 
-        // Start N number of threads for updating position
-        for (int i = 0; i < thread_count; i++)
-        {
-            thread_index[i] = i;
-            pthread_create(&threads[i], NULL, update_position_v2, &thread_input[i]);
-        }
+    // Start simulation - Parallelized with Pthreads, one pool phase per part of the step
+    for (int step = first_step; step < nsteps; step++)
+    {
+        // The symmetric kernel accumulates velocity changes into per-thread scratch rows here
+        phaseStart = get_wall_seconds();
+        pool_run(pool, kernel->acceleration, thread_input, sizeof(ThreadInput));
+        accTime += get_wall_seconds() - phaseStart;
+
+        // ... and sums all rows over each thread's slice of the particles here
+        phaseStart = get_wall_seconds();
+        pool_run(pool, kernel->velocity, thread_input, sizeof(ThreadInput));
+        velTime += get_wall_seconds() - phaseStart;
+
+        phaseStart = get_wall_seconds();
+        pool_run(pool, kernel->position, thread_input, sizeof(ThreadInput));
+        posTime += get_wall_seconds() - phaseStart;
+
+        snapshot_writer_step(snapshots, particles, step + 1);
+        checkpoint_step(&checkpoints, particles, step + 1);
+    }
 
-        // Join N number of threads after updating position
-        for (int i = 0; i < thread_count; i++)
-        {
-            pthread_join(threads[i], NULL);
-        }
+    pool_destroy(pool);
+    for (int s = 0; s < replica_count; s++)
+    {
+        arena_destroy(replica_arena[s]);
     }
-    pthread_mutex_destroy(&mutex);
-    
-#endif
+    affinity_destroy(affinity);
+
+    snapshot_writer_destroy(snapshots);
 
     double totalTime = get_wall_seconds() - startTime;
     printf("Time taken for the simulation of %d particals for %d steps = %lf seconds.\n", N, nsteps, totalTime);
+    printf("Phase times: acceleration = %lf s, velocity = %lf s, position = %lf s (%lf ms per step).\n",
+           accTime, velTime, posTime, nsteps > 0 ? 1000.0 * totalTime / nsteps : 0.0);
 
     // End simulation - Optimized version
 
     // SAVE DATA TO FILE
-    save_file_v1(N, particles);
-
-    free(particles->posx);
-    free(particles->posy);
-    free(particles->mass);
-    free(particles->velx);
-    free(particles->vely);
-    free(particles->accx);
-    free(particles->accy);
-    free(particles->brightness);
-    free(particles);
+    save_particles(N, particles, output_file, nsteps, delta_t);
+
+    free_particles(particles);
     return 0;
 }
 
-#if VERSION == 1
 void *update_acceleration_v1(void *arg)
 {
     ThreadInput *thread_input = (ThreadInput *)arg;
@@ -247,6 +450,9 @@ void *update_acceleration_v1(void *arg)
 
     // Variables needed for calcluations
     double rx, ry, r, rr, div_1_rr;
+    const double *posx = thread_input->force_posx;
+    const double *posy = thread_input->force_posy;
+    const double *mass = thread_input->force_mass;
 
     for (int i = thread_input->start_n; i < thread_input->end_n; i++)
     {
@@ -256,14 +462,14 @@ void *update_acceleration_v1(void *arg)
         {
             if (i != j)
             {
-                rx = thread_input->particles->posx[i] - thread_input->particles->posx[j];
-                ry = thread_input->particles->posy[i] - thread_input->particles->posy[j];
+                rx = posx[i] - posx[j];
+                ry = posy[i] - posy[j];
 
                 r = sqrt(rx * rx + ry * ry);
                 rr = r + thread_input->epsilon;
                 div_1_rr = 1 / (rr * rr * rr);
-                thread_input->particles->accx[i] += thread_input->particles->mass[j] * rx * div_1_rr;
-                thread_input->particles->accy[i] += thread_input->particles->mass[j] * ry * div_1_rr;
+                thread_input->particles->accx[i] += mass[j] * rx * div_1_rr;
+                thread_input->particles->accy[i] += mass[j] * ry * div_1_rr;
             }
         }
     }
@@ -297,11 +503,11 @@ void *update_position_v1(void *arg)
         thread_input->particles->posx[i] += thread_input->particles->velx[i] * thread_input->delta_t;
         thread_input->particles->posy[i] += thread_input->particles->vely[i] * thread_input->delta_t;
     }
+    refresh_replicas(thread_input, start_n, end_n);
 
     return NULL;
 }
 
-#elif VERSION == 2
 void *update_acceleration_v2(void *arg)
 {
     ThreadInput *thread_input = (ThreadInput *)arg;
@@ -311,10 +517,11 @@ void *update_acceleration_v2(void *arg)
     // Variables needed for calcluations
     double rx, ry, r, rr, div_1_rr, rx_div, ry_div;
 
-    double *tmp_velx = malloc(thread_input->N * sizeof(double));
-    double *tmp_vely = malloc(thread_input->N * sizeof(double));
-    memset(tmp_velx, 0, thread_input->N);
-    memset(tmp_vely, 0, thread_input->N);
+    double *tmp_velx = thread_input->scratch_velx + (size_t)thread_input->thread_id * thread_input->N;
+    double *tmp_vely = thread_input->scratch_vely + (size_t)thread_input->thread_id * thread_input->N;
+    const double *posx = thread_input->force_posx;
+    const double *posy = thread_input->force_posy;
+    const double *mass = thread_input->force_mass;
 
     //printf("Velocity-tmp-x: %lf,, %d\n", tmp_velx[3],  thread_input->start_n);
 
@@ -324,8 +531,8 @@ void *update_acceleration_v2(void *arg)
         double tmp_accy = 0.0;
         for (int j = i + 1; j < thread_input->N; j++)
         {
-            rx = thread_input->particles->posx[i] - thread_input->particles->posx[j];
-            ry = thread_input->particles->posy[i] - thread_input->particles->posy[j];
+            rx = posx[i] - posx[j];
+            ry = posy[i] - posy[j];
             r = sqrt(rx * rx + ry * ry);
             rr = r + thread_input->epsilon;
             div_1_rr = thread_input->dtG / (rr * rr * rr);
@@ -335,38 +542,37 @@ void *update_acceleration_v2(void *arg)
             // Calculating the acceleration of the i-th particle based on the forces applied by N-i particles
             //thread_input->particles->accx[i] += thread_input->particles->mass[j] * rx_div / thread_input->delta_t;
             //thread_input->particles->accy[i] += thread_input->particles->mass[j] * ry_div / thread_input->delta_t;
-            tmp_velx[i] += thread_input->particles->mass[j] * rx_div;
-            tmp_vely[i] += thread_input->particles->mass[j] * ry_div;
+            tmp_velx[i] += mass[j] * rx_div;
+            tmp_vely[i] += mass[j] * ry_div;
 	    // Substracting the velocity change on the j-th particle due to the equal and opposite reaction
-            tmp_velx[j] -=  thread_input->particles->mass[i] * rx_div;
-            tmp_vely[j] -=  thread_input->particles->mass[i] * ry_div;
+            tmp_velx[j] -=  mass[i] * rx_div;
+            tmp_vely[j] -=  mass[i] * ry_div;
         }
     }
 
-    //printf("Velocity-tmp-x after loop: %lf, %d\n", tmp_velx[3],  thread_input->start_n);
-
-    for (int m = 0; m < thread_input->N; m++){
-        pthread_mutex_lock(&mutex);
-        thread_input->particles->velx[m] += tmp_velx[m];
-        thread_input->particles->vely[m] += tmp_vely[m];
-        pthread_mutex_unlock(&mutex);
-    }
-
-    //printf("Velocity--x after update: %lf, %d\n", thread_input->particles->velx[3],  thread_input->start_n);
-
     return NULL;
 }
 
-void *update_velocity_v2(void *arg)
+void *reduce_velocity_v2(void *arg)
 {
     ThreadInput *thread_input = (ThreadInput *)arg;
-    int start_n = thread_input->start_n;
-    int end_n = thread_input->end_n;
+    const int N = thread_input->N;
 
-    for (int i = thread_input->start_n; i < thread_input->end_n; i++)
+    // Equal slices of the output, independent of how the pair loop was split
+    int lo = (int)((long)N * thread_input->thread_id / thread_input->thread_count);
+    int hi = (int)((long)N * (thread_input->thread_id + 1) / thread_input->thread_count);
+
+    for (int t = 0; t < thread_input->thread_count; t++)
     {
-        thread_input->particles->velx[i] += thread_input->particles->accx[i] * thread_input->delta_t;
-        thread_input->particles->vely[i] += thread_input->particles->accy[i] * thread_input->delta_t;
+        double *tmp_velx = thread_input->scratch_velx + (size_t)t * N;
+        double *tmp_vely = thread_input->scratch_vely + (size_t)t * N;
+        for (int m = lo; m < hi; m++)
+        {
+            thread_input->particles->velx[m] += tmp_velx[m];
+            thread_input->particles->vely[m] += tmp_vely[m];
+            tmp_velx[m] = 0.0;
+            tmp_vely[m] = 0.0;
+        }
     }
 
     return NULL;
@@ -375,115 +581,177 @@ void *update_velocity_v2(void *arg)
 void *update_position_v2(void *arg)
 {
     ThreadInput *thread_input = (ThreadInput *)arg;
-    int start_n = thread_input->start_n;
-    int end_n = thread_input->end_n;
 
-    for (int i = thread_input->start_n; i < thread_input->end_n; i++)
+    // start_n/end_n are balanced for the pair loop, this sweep costs the same for every particle
+    int lo = (int)((long)thread_input->N * thread_input->thread_id / thread_input->thread_count);
+    int hi = (int)((long)thread_input->N * (thread_input->thread_id + 1) / thread_input->thread_count);
+
+    for (int i = lo; i < hi; i++)
     {
         thread_input->particles->posx[i] += thread_input->particles->velx[i] * thread_input->delta_t;
         thread_input->particles->posy[i] += thread_input->particles->vely[i] * thread_input->delta_t;
     }
+    refresh_replicas(thread_input, lo, hi);
 
     return NULL;
 }
 
-#endif
+void *update_acceleration_simd(void *arg)
+{
+    ThreadInput *thread_input = (ThreadInput *)arg;
 
+    // The block kernel reads positions and masses through Particles, so point a copy at the force arrays
+    Particles view = *thread_input->particles;
+    view.posx = (double *)thread_input->force_posx;
+    view.posy = (double *)thread_input->force_posy;
+    view.mass = (double *)thread_input->force_mass;
+    for (int i = thread_input->start_n; i < thread_input->end_n; i++)
+    {
+        view.accx[i] = 0.0;
+        view.accy[i] = 0.0;
+    }
+    thread_input->block(&view, thread_input->start_n, thread_input->end_n, 0, thread_input->N, thread_input->epsilon);
 
-double get_wall_seconds()
-{
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    double seconds = tv.tv_sec + (double)tv.tv_usec / 1000000;
-    return seconds;
+    return NULL;
 }
 
-Particles *read_data_v1(int particle_count, char *filename)
+/* Sets start_n/end_n of every thread: ranges with equal pair counts for
+   the symmetric loop, equal slices otherwise. */
+void set_kernel_bounds(ThreadInput *thread_input, int thread_count, int N, const ThreadedKernel *kernel)
 {
-
-    /* Open input file and determine its size. */
-    FILE *input_file = fopen(filename, "rb");
-
-    if (!input_file)
+    int bounds[thread_count + 1];
+    if (kernel->pair_bounds)
     {
-        printf("read_doubles_from_file error: failed to open input file '%s'.\n", filename);
-        return NULL;
+        partition_pairs(N, thread_count, bounds);
     }
-
-    /* Get filesize using fseek() and ftell(). */
-    fseek(input_file, 0L, SEEK_END);
-    size_t fileSize = ftell(input_file);
-
-    /* Now use fseek() again to set file position back to beginning of the file. */
-    fseek(input_file, 0L, SEEK_SET);
-
-    if (fileSize != 6 * particle_count * sizeof(double))
+    else
+    {
+        for (int i = 0; i <= thread_count; i++)
+        {
+            bounds[i] = (int)((long)N * i / thread_count);
+        }
+    }
+    for (int i = 0; i < thread_count; i++)
     {
-        printf("read_doubles_from_file error: size of input file '%s' does not match the given n.\n", filename);
-        printf("For n = %d the file size is expected to be (n * sizeof(double)) = %lu but the actual file size is %lu.\n",
-               particle_count, 6 * particle_count * sizeof(double), fileSize);
-        return NULL;
+        thread_input[i].start_n = bounds[i];
+        thread_input[i].end_n = bounds[i + 1];
     }
+}
 
-    double buffer[6 * particle_count];
-    if (!fread(buffer, sizeof(char), fileSize, input_file))
+/* Times the acceleration phase of every kernel on the pool and returns the
+   index of the fastest. Only accx/accy and the scratch rows are written,
+   and the scratch rows are cleared again before the first step. */
+int calibrate_kernels(ThreadPool *pool, ThreadInput *thread_input, int thread_count, int N, double *seconds)
+{
+    int best = 0;
+    for (int k = 0; k < KERNEL_COUNT; k++)
     {
-        printf("Failed to read.\n");
+        set_kernel_bounds(thread_input, thread_count, N, &kernels[k]);
+        double fastest = -1.0, spent = 0.0;
+        for (int call = 0; call < CALIBRATION_CALLS && spent < CALIBRATION_SECONDS; call++)
+        {
+            double start = get_wall_seconds();
+            pool_run(pool, kernels[k].acceleration, thread_input, sizeof(ThreadInput));
+            double elapsed = get_wall_seconds() - start;
+            fastest = fastest < 0.0 || elapsed < fastest ? elapsed : fastest;
+            spent += elapsed;
+        }
+        if (kernels[k].scratch)
+        {
+            memset(thread_input[0].scratch_velx, 0, (size_t)thread_count * N * sizeof(double));
+            memset(thread_input[0].scratch_vely, 0, (size_t)thread_count * N * sizeof(double));
+        }
+        seconds[k] = fastest;
+        best = fastest < seconds[best] ? k : best;
     }
+    return best;
+}
 
-    Particles *particles = malloc(sizeof(Particles));
+/* Copies rows lo..hi-1 of the new positions into every per-socket replica.
+   Each thread writes the rows it just updated, so the copies are complete
+   once the position phase returns. */
+void refresh_replicas(ThreadInput *thread_input, int lo, int hi)
+{
+    for (int s = 0; s < thread_input->replica_count; s++)
+    {
+        memcpy(thread_input->replica_posx[s] + lo, thread_input->particles->posx + lo, (hi - lo) * sizeof(double));
+        memcpy(thread_input->replica_posy[s] + lo, thread_input->particles->posy + lo, (hi - lo) * sizeof(double));
+    }
+}
 
-    // Particle *particles = malloc(particle_count * sizeof(Particle));
+/* First touch of everything a pinned thread works on. Each thread copies
+   the same equal slice of every array that the reduction and position
+   phases later update, clears its own scratch rows, and fills its share of
+   the replica on its socket. */
+void *place_particles(void *arg)
+{
+    PlaceInput *input = (PlaceInput *)arg;
+    const int N = input->N;
+    int lo = (int)((long)N * input->thread_id / input->thread_count);
+    int hi = (int)((long)N * (input->thread_id + 1) / input->thread_count);
+    size_t bytes = (hi - lo) * sizeof(double);
+
+    const double *source[8] = {input->source->posx, input->source->posy, input->source->mass,
+                               input->source->velx, input->source->vely, input->source->accx,
+                               input->source->accy, input->source->brightness};
+    double *target[8] = {input->target->posx, input->target->posy, input->target->mass,
+                         input->target->velx, input->target->vely, input->target->accx,
+                         input->target->accy, input->target->brightness};
+    for (int f = 0; f < 8; f++)
+    {
+        memcpy(target[f] + lo, source[f] + lo, bytes);
+    }
 
-    // Allocate memory for each array member
-    particles->posx = malloc(particle_count * sizeof(double));
-    particles->posy = malloc(particle_count * sizeof(double));
-    particles->mass = malloc(particle_count * sizeof(double));
-    particles->velx = malloc(particle_count * sizeof(double));
-    particles->vely = malloc(particle_count * sizeof(double));
-    particles->accx = malloc(particle_count * sizeof(double));
-    // memset(particles->accx, 0, particle_count);
-    particles->accy = malloc(particle_count * sizeof(double));
-    // memset(particles->accy, 0, particle_count);
-    particles->brightness = malloc(particle_count * sizeof(double));
+    if (input->scratch_velx != NULL)
+    {
+        memset(input->scratch_velx + (size_t)input->thread_id * N, 0, N * sizeof(double));
+        memset(input->scratch_vely + (size_t)input->thread_id * N, 0, N * sizeof(double));
+    }
 
-    for (int i = 0; i < particle_count; i++)
+    if (input->replica[0] != NULL)
     {
-        particles->posx[i] = buffer[(6 * i) + 0];
-        particles->posy[i] = buffer[(6 * i) + 1];
-        particles->mass[i] = buffer[(6 * i) + 2];
-        particles->velx[i] = buffer[(6 * i) + 3];
-        particles->vely[i] = buffer[(6 * i) + 4];
-        particles->brightness[i] = buffer[(6 * i) + 5];
-        particles->accx[i] = 0.0;
-        particles->accy[i] = 0.0;
-        // we don't initiate accx and accy at this point - the values will be null
+        int first = (int)((long)N * input->socket_rank / input->socket_size);
+        int last = (int)((long)N * (input->socket_rank + 1) / input->socket_size);
+        for (int f = 0; f < 3; f++)
+        {
+            memcpy(input->replica[f] + first, source[f] + first, (last - first) * sizeof(double));
+        }
     }
 
-    fclose(input_file);
-    return particles;
+    return NULL;
 }
 
-void save_file_v1(int particle_count, Particles *particles)
+/* Splits rows 0..N-1 of the j = i + 1 loop so that every thread gets about
+   the same number of pairs. Row i holds N - 1 - i pairs, so the first
+   ranges are short and the last ones long. bounds[k] is the first row of
+   thread k and bounds[thread_count] = N. */
+void partition_pairs(int N, int thread_count, int *bounds)
 {
+    const double total = 0.5 * (double)N * (N - 1);
+    double done = 0.0;
+    int i = 0;
 
-    FILE *output_file = fopen("result.gal", "wb");
-    if (!output_file)
+    bounds[0] = 0;
+    for (int k = 1; k < thread_count; k++)
     {
-        printf("Failed to open the output file.\n");
-        return;
+        double target = total * k / thread_count;
+        // Take row i if at least half of its pairs fall below the target
+        while (i < N && done + 0.5 * (N - 1 - i) < target)
+        {
+            done += N - 1 - i;
+            i++;
+        }
+        bounds[k] = i;
     }
+    bounds[thread_count] = N;
+}
 
-    for (int i = 0; i < particle_count; i++)
-    {
-        fwrite(&(particles->posx[i]), sizeof(double), 1, output_file);
-        fwrite(&(particles->posy[i]), sizeof(double), 1, output_file);
-        fwrite(&(particles->mass[i]), sizeof(double), 1, output_file);
-        fwrite(&(particles->velx[i]), sizeof(double), 1, output_file);
-        fwrite(&(particles->vely[i]), sizeof(double), 1, output_file);
-        fwrite(&(particles->brightness[i]), sizeof(double), 1, output_file);
-    }
-    fclose(output_file);
+double get_wall_seconds()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    double seconds = tv.tv_sec + (double)tv.tv_usec / 1000000;
+    return seconds;
 }
 
 void print_data(int N, Particles *particles)
@@ -0,0 +1,109 @@
+#include <stdlib.h>
+#include "thread_pool.h"
+
+struct WorkerArg
+{
+    ThreadPool *pool;
+    int id;
+};
+
+static void *worker_main(void *arg)
+{
+    struct WorkerArg *worker = (struct WorkerArg *)arg;
+    ThreadPool *pool = worker->pool;
+    unsigned long seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (1)
+    {
+        // Sleep until the main thread publishes a new phase
+        while (pool->generation == seen && !pool->shutdown)
+        {
+            pthread_cond_wait(&pool->work_ready, &pool->lock);
+        }
+        if (pool->shutdown)
+        {
+            break;
+        }
+        seen = pool->generation;
+        void *(*task)(void *) = pool->task;
+        void *task_arg = pool->args + worker->id * pool->arg_size;
+        pthread_mutex_unlock(&pool->lock);
+
+        task(task_arg);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->pending == 0)
+        {
+            pthread_cond_signal(&pool->work_done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+ThreadPool *pool_create(int thread_count)
+{
+    ThreadPool *pool = malloc(sizeof(ThreadPool));
+    pool->thread_count = thread_count;
+    pool->generation = 0;
+    pool->pending = 0;
+    pool->shutdown = 0;
+    pool->task = NULL;
+    pool->args = NULL;
+    pool->arg_size = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_ready, NULL);
+    pthread_cond_init(&pool->work_done, NULL);
+
+    pool->threads = malloc(thread_count * sizeof(pthread_t));
+    pool->workers = malloc(thread_count * sizeof(struct WorkerArg));
+    for (int i = 1; i < thread_count; i++)
+    {
+        pool->workers[i].pool = pool;
+        pool->workers[i].id = i;
+        pthread_create(&pool->threads[i], NULL, worker_main, &pool->workers[i]);
+    }
+    return pool;
+}
+
+void pool_run(ThreadPool *pool, void *(*task)(void *), void *args, size_t arg_size)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->args = (char *)args;
+    pool->arg_size = arg_size;
+    pool->pending = pool->thread_count - 1;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    // The calling thread takes the first share of the work
+    task(args);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0)
+    {
+        pthread_cond_wait(&pool->work_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void pool_destroy(ThreadPool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 1; i < pool->thread_count; i++)
+    {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_cond_destroy(&pool->work_done);
+    free(pool->threads);
+    free(pool->workers);
+    free(pool);
+}
@@ -0,0 +1,49 @@
+#ifndef _thread_pool_h
+#define _thread_pool_h
+
+#include <pthread.h>
+#include <stddef.h>
+
+/*
+ * A fixed set of worker threads that lives for the whole simulation. Each
+ * call to pool_run is one phase: every thread runs the same task on its own
+ * argument and the call returns once all of them are finished.
+ */
+typedef struct
+{
+    int thread_count;
+    pthread_t *threads;
+    struct WorkerArg *workers;
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    unsigned long generation;
+    int pending;
+    int shutdown;
+    void *(*task)(void *);
+    char *args;
+    size_t arg_size;
+} ThreadPool;
+
+/*
+ * Function: pool_create
+ * Usage: ThreadPool *pool = pool_create(thread_count);
+ * ----------------------------------------------------
+ * Starts thread_count - 1 workers. The calling thread acts as worker 0
+ * inside pool_run, so thread_count = 1 never spawns anything.
+ */
+ThreadPool *pool_create(int thread_count);
+
+/*
+ * Function: pool_run
+ * Usage: pool_run(pool, update_position_v2, thread_input, sizeof(ThreadInput));
+ * -----------------------------------------------------------------------------
+ * Runs task(args + i * arg_size) on thread i for every i < thread_count and
+ * waits for all of them. The workers are woken by bumping a generation
+ * counter, so no thread is created or joined per phase.
+ */
+void pool_run(ThreadPool *pool, void *(*task)(void *), void *args, size_t arg_size);
+
+void pool_destroy(ThreadPool *pool);
+
+#endif
@@ -0,0 +1,152 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "transport.h"
+
+/*
+ * Layout of the shared mapping: the control block, then two position
+ * buffers (posx and posy of all N particles, one per step parity) and the
+ * gather area of TRANSPORT_MAX_FIELDS * N doubles.
+ */
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    int gathered;
+    // Steps completed by every rank, published[size] entries follow the struct
+    int published[];
+} ShmControl;
+
+typedef struct
+{
+    char *base;
+    size_t bytes;
+    ShmControl *control;
+    double *positions[2][2];
+    double *gather_area;
+} ShmState;
+
+static void shm_publish(Transport *transport, int step, const double *posx, const double *posy)
+{
+    ShmState *shm = (ShmState *)transport->state;
+    int lo = transport->bounds[transport->rank];
+    int count = transport->bounds[transport->rank + 1] - lo;
+    memcpy(shm->positions[step % 2][0] + lo, posx + lo, count * sizeof(double));
+    memcpy(shm->positions[step % 2][1] + lo, posy + lo, count * sizeof(double));
+
+    pthread_mutex_lock(&shm->control->lock);
+    shm->control->published[transport->rank] = step;
+    pthread_cond_broadcast(&shm->control->changed);
+    pthread_mutex_unlock(&shm->control->lock);
+}
+
+static void shm_fetch(Transport *transport, int step, int src, const double **posx, const double **posy)
+{
+    ShmState *shm = (ShmState *)transport->state;
+    pthread_mutex_lock(&shm->control->lock);
+    while (shm->control->published[src] < step)
+    {
+        pthread_cond_wait(&shm->control->changed, &shm->control->lock);
+    }
+    pthread_mutex_unlock(&shm->control->lock);
+
+    // A rank needs every block of step before it publishes step + 1, so this buffer is not overwritten under us
+    *posx = shm->positions[step % 2][0];
+    *posy = shm->positions[step % 2][1];
+}
+
+static void shm_gather(Transport *transport, double **fields, int field_count)
+{
+    ShmState *shm = (ShmState *)transport->state;
+    const int N = transport->N;
+    int lo = transport->bounds[transport->rank];
+    int count = transport->bounds[transport->rank + 1] - lo;
+    for (int f = 0; f < field_count; f++)
+    {
+        memcpy(shm->gather_area + (size_t)f * N + lo, fields[f] + lo, count * sizeof(double));
+    }
+
+    pthread_mutex_lock(&shm->control->lock);
+    shm->control->gathered++;
+    pthread_cond_broadcast(&shm->control->changed);
+    while (transport->rank == 0 && shm->control->gathered < transport->size)
+    {
+        pthread_cond_wait(&shm->control->changed, &shm->control->lock);
+    }
+    pthread_mutex_unlock(&shm->control->lock);
+
+    if (transport->rank == 0)
+    {
+        for (int f = 0; f < field_count; f++)
+        {
+            memcpy(fields[f], shm->gather_area + (size_t)f * N, N * sizeof(double));
+        }
+    }
+}
+
+static void shm_close(Transport *transport)
+{
+    ShmState *shm = (ShmState *)transport->state;
+    munmap(shm->base, shm->bytes);
+    free(shm);
+    free(transport);
+}
+
+Transport *transport_shm_create(int ranks, int N, const int *bounds, int first_step, const double *posx,
+                                const double *posy)
+{
+    size_t control_bytes = sizeof(ShmControl) + ranks * sizeof(int);
+    // Keep the arrays on their own cache lines
+    control_bytes = (control_bytes + 63) / 64 * 64;
+    size_t array_bytes = ((size_t)N * sizeof(double) + 63) / 64 * 64;
+    size_t bytes = control_bytes + (4 + TRANSPORT_MAX_FIELDS) * array_bytes;
+
+    char *base = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    ShmState *shm = malloc(sizeof(ShmState));
+    shm->base = base;
+    shm->bytes = bytes;
+    shm->control = (ShmControl *)base;
+    for (int b = 0; b < 2; b++)
+    {
+        shm->positions[b][0] = (double *)(base + control_bytes + (2 * b) * array_bytes);
+        shm->positions[b][1] = (double *)(base + control_bytes + (2 * b + 1) * array_bytes);
+    }
+    shm->gather_area = (double *)(base + control_bytes + 4 * array_bytes);
+
+    pthread_mutexattr_t mutex_attr;
+    pthread_mutexattr_init(&mutex_attr);
+    pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&shm->control->lock, &mutex_attr);
+    pthread_mutexattr_destroy(&mutex_attr);
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED);
+    pthread_cond_init(&shm->control->changed, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+    shm->control->gathered = 0;
+
+    memcpy(shm->positions[first_step % 2][0], posx, N * sizeof(double));
+    memcpy(shm->positions[first_step % 2][1], posy, N * sizeof(double));
+    for (int r = 0; r < ranks; r++)
+    {
+        shm->control->published[r] = first_step;
+    }
+
+    Transport *transport = malloc(sizeof(Transport));
+    transport->rank = 0;
+    transport->size = ranks;
+    transport->N = N;
+    transport->bounds = bounds;
+    transport->state = shm;
+    transport->publish = shm_publish;
+    transport->fetch = shm_fetch;
+    transport->gather = shm_gather;
+    transport->close = shm_close;
+    return transport;
+}
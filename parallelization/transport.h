@@ -0,0 +1,47 @@
+#ifndef _transport_h
+#define _transport_h
+
+/*
+ * How the ranks of a distributed run see each other's particles. Rank k
+ * owns particles bounds[k] .. bounds[k + 1] - 1. Every step each rank
+ * publishes the new positions of its own block and fetches the blocks of
+ * the others; fetch only waits for the one block it asks for, so a rank
+ * can work on the blocks that are already there while the rest are still
+ * being computed. The operations are function pointers so that a socket
+ * or MPI transport can replace the shared memory one without touching the
+ * force loop.
+ */
+typedef struct Transport
+{
+    int rank;
+    int size;
+    int N;
+    const int *bounds;
+    void *state;
+    // Makes this rank's positions after step steps available to all ranks
+    void (*publish)(struct Transport *transport, int step, const double *posx, const double *posy);
+    // Points posx/posy at block src after step steps, waiting until it is published
+    void (*fetch)(struct Transport *transport, int step, int src, const double **posx, const double **posy);
+    // Collects the own block of every field on rank 0, the others return at once
+    void (*gather)(struct Transport *transport, double **fields, int field_count);
+    void (*close)(struct Transport *transport);
+} Transport;
+
+// gather handles at most this many fields per call
+#define TRANSPORT_MAX_FIELDS 4
+
+/*
+ * Function: transport_shm_create
+ * Usage: Transport *transport = transport_shm_create(ranks, N, bounds, first_step, posx, posy);
+ * ---------------------------------------------------------------------------------------------
+ * Creates a shared memory transport for ranks processes that are forked
+ * after this call; each child sets transport->rank to its own rank. The
+ * positions after first_step steps are published for every rank. Blocks
+ * are double buffered by step parity and readers get pointers straight
+ * into the shared mapping, so fetch copies nothing. Returns NULL if the
+ * mapping cannot be created.
+ */
+Transport *transport_shm_create(int ranks, int N, const int *bounds, int first_step, const double *posx,
+                                const double *posy);
+
+#endif